@@ -4,19 +4,32 @@
 // Default workload: CPU-bound loop
 // - Good for demonstrating scaling, queue contention, and scheduling overhead.
 // Optional: sleep-based workload (--mode sleep) to simulate IO-bound tasks.
+// Optional: open-loop load (--rate / --rates) that submits on a fixed or Poisson schedule
+// and reports latency percentiles instead of closed-loop throughput.
 
 #include "ThreadPool.hpp"
+#include "AsyncLogSink.hpp"
+#include "JobProfiler.hpp"
+#include "JobRecorder.hpp"
+#include "JobTracer.hpp"
+#include "ShardedMetrics.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/spdlog.h>
 
 using Clock = std::chrono::steady_clock;//monotonic
@@ -37,6 +50,43 @@ struct Args {
     int min_sleep_us = 1000;
 
     int shutdown_timeout_s = 120;
+
+    std::string trace_path; // Chrome trace JSON written at shutdown when set
+    size_t trace_events = 1 << 16; // per-thread ring size
+
+    // Per-job logging: off (warn level, the default), sync (info to log_file through
+    // spdlog's synchronous sink) or async (same file through AsyncLogSink).
+    std::string log = "off";
+    std::string log_file = "bench_log.txt";
+
+    bool profile = false;     // per-job CPU cost profile
+    bool profile_csw = false; // also sample context switches (getrusage)
+
+    // Open loop: when rates is non-empty, producers submit --jobs jobs per rate on a
+    // schedule (jobs/sec across all producers) instead of as fast as backpressure allows.
+    std::vector<double> rates;
+    std::string arrival = "fixed"; // fixed or poisson inter-arrival times
+    size_t producers = 1;
+    double knee_factor = 10.0; // p99 growth over the lowest rate that counts as saturated
+    double high_share = 0.0;   // open loop: fraction of jobs at priority 0 (the rest are 10)
+    uint64_t shed_target_us = 0; // open loop: CoDel load-shedding target; 0 = off
+    size_t reserve = 0;          // open loop: workers reserved for priority-0 jobs
+
+    // Sweep: closed-loop runs over every combination of these lists (empty = the single
+    // value above), each point repeated after warmup runs.
+    std::vector<size_t> sweep_threads, sweep_queue, sweep_producers, sweep_iters;
+    size_t warmup = 1;
+    size_t repeats = 3;
+    std::string sweep_format = "csv"; // csv or json
+    std::string sweep_out;            // stdout when empty
+
+    std::string record_path;   // JobRecorder output for this run
+    std::string replay_path;   // replay this JobRecorder trace instead of the generated load
+    double replay_speed = 1.0; // >1 compresses inter-arrival times
+
+    bool sweep() const {
+        return !sweep_threads.empty() || !sweep_queue.empty() || !sweep_producers.empty() || !sweep_iters.empty();
+    }
 };
 
 static void print_usage(const char* exe) {
@@ -51,6 +101,31 @@ static void print_usage(const char* exe) {
         << "  --sleep_us N        Sleep microseconds per job when mode=sleep (default: 200)\n"
         << "  --min_sleep_us N    Warn if sleep_us is below this threshold (default: 1000)\n"
         << "  --shutdown_s N      Shutdown wait timeout seconds (default: 120)\n"
+        << "  --trace FILE        Write a Chrome/Perfetto job trace at shutdown\n"
+        << "  --trace_events N    Trace events kept per thread (default: 65536)\n"
+        << "  --log off|sync|async Per-job info logging to --log_file (default: off)\n"
+        << "  --log_file FILE     Log file for --log sync|async (default: bench_log.txt)\n"
+        << "  --profile           Print per-job-name CPU cost profile\n"
+        << "  --profile_csw       --profile plus context switches per job\n"
+        << "  --producers N       Submitting threads; closed loop splits --jobs across them (default: 1)\n"
+        << "  --sweep_threads L   Sweep: comma-separated thread counts, e.g. 1,2,4,8\n"
+        << "  --sweep_queue L     Sweep: comma-separated queue sizes\n"
+        << "  --sweep_producers L Sweep: comma-separated producer counts\n"
+        << "  --sweep_iters L     Sweep: comma-separated --iters values (job granularity)\n"
+        << "  --warmup N          Sweep: unmeasured runs before each point (default: 1)\n"
+        << "  --repeats N         Sweep: measured runs per point (default: 3)\n"
+        << "  --sweep_format csv|json  Sweep output format (default: csv)\n"
+        << "  --sweep_out FILE    Sweep output file (default: stdout)\n"
+        << "  --record FILE       Record submitted jobs (JobRecorder) for --replay\n"
+        << "  --replay FILE       Replay a recording: same arrivals, priorities, timeouts and run times\n"
+        << "  --replay_speed X    Divide recorded inter-arrival times by X (default: 1)\n"
+        << "  --rate R            Open loop: submit --jobs jobs at R jobs/sec and report latency\n"
+        << "  --rates R1,R2,...   Open loop at each rate in turn and report the saturation knee\n"
+        << "  --arrival fixed|poisson  Open-loop inter-arrival times (default: fixed)\n"
+        << "  --knee_factor F     p99 growth over the lowest rate treated as saturated (default: 10)\n"
+        << "  --high_share F      Open loop: fraction of jobs submitted at priority 0, the rest at 10 (default: 0)\n"
+        << "  --shed_target_us N  Open loop: shed priority-10 jobs once queue wait stays above N us (default: off)\n"
+        << "  --reserve N         Open loop: reserve N of --threads workers for priority-0 jobs (default: 0)\n"
         << "  --help              Show this message\n";
 }
 
@@ -81,6 +156,40 @@ static bool parse_i32(const char* s, int& out) {
     return true;
 }
 
+static bool parse_double(const char* s, double& out) {
+    if (!s || !*s) return false;
+    char* end = nullptr;
+    errno = 0;
+    double v = std::strtod(s, &end);
+    if (errno != 0 || end == s || *end != '\0') return false;
+    out = v;
+    return true;
+}
+
+static bool parse_rates(const std::string& list, std::vector<double>& out) {
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        const size_t comma = std::min(list.find(',', begin), list.size());
+        double rate = 0.0;
+        if (!parse_double(list.substr(begin, comma - begin).c_str(), rate) || rate <= 0.0) return false;
+        out.push_back(rate);
+        begin = comma + 1;
+    }
+    return !out.empty();
+}
+
+static bool parse_sizes(const std::string& list, std::vector<size_t>& out) {
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        const size_t comma = std::min(list.find(',', begin), list.size());
+        size_t value = 0;
+        if (!parse_size(list.substr(begin, comma - begin).c_str(), value) || value == 0) return false;
+        out.push_back(value);
+        begin = comma + 1;
+    }
+    return !out.empty();
+}
+
 static Args parse_args(int argc, char** argv) {
     Args a;
     for (int i = 1; i < argc; ++i) {
@@ -121,6 +230,77 @@ static Args parse_args(int argc, char** argv) {
                 std::cerr << "Invalid --shutdown_s\n";
                 std::exit(2);
             }
+        } else if (key == "--trace") {
+            a.trace_path = need_value("--trace");
+        } else if (key == "--trace_events") {
+            parse_size(need_value("--trace_events"), a.trace_events);
+        } else if (key == "--log") {
+            a.log = need_value("--log");
+        } else if (key == "--log_file") {
+            a.log_file = need_value("--log_file");
+        } else if (key == "--profile") {
+            a.profile = true;
+        } else if (key == "--profile_csw") {
+            a.profile = true;
+            a.profile_csw = true;
+        } else if (key == "--rate" || key == "--rates") {
+            a.rates.clear();
+            if (!parse_rates(need_value(key.c_str()), a.rates)) {
+                std::cerr << "Invalid " << key << "\n";
+                std::exit(2);
+            }
+        } else if (key == "--sweep_threads" || key == "--sweep_queue" || key == "--sweep_producers" ||
+                   key == "--sweep_iters") {
+            auto& list = key == "--sweep_threads" ? a.sweep_threads
+                       : key == "--sweep_queue"   ? a.sweep_queue
+                       : key == "--sweep_producers" ? a.sweep_producers
+                                                    : a.sweep_iters;
+            list.clear();
+            if (!parse_sizes(need_value(key.c_str()), list)) {
+                std::cerr << "Invalid " << key << "\n";
+                std::exit(2);
+            }
+        } else if (key == "--warmup") {
+            parse_size(need_value("--warmup"), a.warmup);
+        } else if (key == "--repeats") {
+            parse_size(need_value("--repeats"), a.repeats);
+        } else if (key == "--sweep_format") {
+            a.sweep_format = need_value("--sweep_format");
+        } else if (key == "--sweep_out") {
+            a.sweep_out = need_value("--sweep_out");
+        } else if (key == "--record") {
+            a.record_path = need_value("--record");
+        } else if (key == "--replay") {
+            a.replay_path = need_value("--replay");
+        } else if (key == "--replay_speed") {
+            if (!parse_double(need_value("--replay_speed"), a.replay_speed) || a.replay_speed <= 0.0) {
+                std::cerr << "Invalid --replay_speed\n";
+                std::exit(2);
+            }
+        } else if (key == "--arrival") {
+            a.arrival = need_value("--arrival");
+        } else if (key == "--producers") {
+            parse_size(need_value("--producers"), a.producers);
+        } else if (key == "--knee_factor") {
+            if (!parse_double(need_value("--knee_factor"), a.knee_factor)) {
+                std::cerr << "Invalid --knee_factor\n";
+                std::exit(2);
+            }
+        } else if (key == "--high_share") {
+            if (!parse_double(need_value("--high_share"), a.high_share) || a.high_share < 0.0 || a.high_share > 1.0) {
+                std::cerr << "Invalid --high_share\n";
+                std::exit(2);
+            }
+        } else if (key == "--reserve") {
+            if (!parse_size(need_value("--reserve"), a.reserve)) {
+                std::cerr << "Invalid --reserve\n";
+                std::exit(2);
+            }
+        } else if (key == "--shed_target_us") {
+            if (!parse_u64(need_value("--shed_target_us"), a.shed_target_us)) {
+                std::cerr << "Invalid --shed_target_us\n";
+                std::exit(2);
+            }
         } else if (key == "--min_sleep_us") {
             if (!parse_i32(need_value("--min_sleep_us"), a.min_sleep_us)) {
                 std::cerr << "Invalid --min_sleep_us\n";
@@ -133,12 +313,30 @@ static Args parse_args(int argc, char** argv) {
         }
     }
     if (a.threads == 0) a.threads = 1;
+    if (a.reserve >= a.threads && a.reserve > 0) {
+        std::cerr << "--reserve must be below --threads\n";
+        std::exit(2);
+    }
     if (a.queue == 0) a.queue = 1;
     if (a.jobs == 0) a.jobs = 1;
+    if (a.log != "off" && a.log != "sync" && a.log != "async") {
+        std::cerr << "Invalid --log. Use off, sync or async.\n";
+        std::exit(2);
+    }
     if (a.mode != "cpu" && a.mode != "sleep") {
         std::cerr << "Invalid --mode. Use cpu or sleep.\n";
         std::exit(2);
     }
+    if (a.arrival != "fixed" && a.arrival != "poisson") {
+        std::cerr << "Invalid --arrival. Use fixed or poisson.\n";
+        std::exit(2);
+    }
+    if (a.producers == 0) a.producers = 1;
+    if (a.repeats == 0) a.repeats = 1;
+    if (a.sweep_format != "csv" && a.sweep_format != "json") {
+        std::cerr << "Invalid --sweep_format. Use csv or json.\n";
+        std::exit(2);
+    }
     return a;
 }
 
@@ -152,17 +350,501 @@ static inline uint64_t cpu_work(uint64_t iters) {
     return static_cast<uint64_t>(x);
 }
 
+// Closed loop: submits args.jobs jobs as fast as backpressure allows, from the calling
+// thread or split across args.producers threads.
+static void submit_closed_loop(ThreadPool& pool, const Args& args, std::atomic<size_t>& completed,
+                               std::atomic<uint64_t>& checksum) {
+    auto submit_range = [&](size_t first, size_t stride) {
+        if (args.mode == "cpu") {
+            for (size_t i = first; i < args.jobs; i += stride) {
+                JobMetadata meta(static_cast<int>(i), "bench_cpu");
+                meta.allow_retry = false;
+                pool.submit(std::move(meta), [&completed, &checksum, iters = args.iters]() {
+                    uint64_t v = cpu_work(iters);
+                    checksum.fetch_add(v, std::memory_order_relaxed);//don't care about ordering
+                    completed.fetch_add(1, std::memory_order_release);
+                });
+            }
+        } else { // sleep
+            for (size_t i = first; i < args.jobs; i += stride) {
+                JobMetadata meta(static_cast<int>(i), "bench_sleep");
+                meta.allow_retry = false;
+                pool.submit(std::move(meta), [&completed, us = args.sleep_us]() {
+                    std::this_thread::sleep_for(std::chrono::microseconds(us));
+                    completed.fetch_add(1, std::memory_order_release);
+                });
+            }
+        }
+    };
+
+    if (args.producers <= 1) {
+        submit_range(0, 1);
+        return;
+    }
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < args.producers; ++p) {
+        producers.emplace_back(submit_range, p, args.producers);
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+}
+
+// One timed closed-loop run on a fresh pool; returns jobs/sec.
+static double measure_throughput(const Args& args) {
+    std::atomic<size_t> completed{0};
+    std::atomic<uint64_t> checksum{0};
+    ThreadPool pool(args.threads, args.queue);
+    const auto t_start = Clock::now();
+    submit_closed_loop(pool, args, completed, checksum);
+    pool.shutdown(args.shutdown_timeout_s);
+    const double elapsed_s = std::chrono::duration<double>(Clock::now() - t_start).count();
+    if (completed.load(std::memory_order_acquire) != args.jobs) {
+        std::cerr << "WARNING: run did not complete all jobs within shutdown timeout\n";
+    }
+    return completed.load(std::memory_order_acquire) / (elapsed_s > 0 ? elapsed_s : 1e-9);
+}
+
+struct SweepPoint {
+    size_t threads, queue, producers;
+    uint64_t iters;
+    double mean = 0.0, stddev = 0.0; // jobs/sec over the measured repeats
+    double speedup = 0.0, efficiency = 0.0;
+};
+
+// Runs every combination of the sweep lists (an empty list means the single regular
+// value). Speedup and parallel efficiency are relative to the smallest thread count with
+// the same queue, producers and iters.
+static int sweep_main(const Args& args) {
+    auto or_default = [](const std::vector<size_t>& list, size_t value) {
+        return list.empty() ? std::vector<size_t>{value} : list;
+    };
+    const auto thread_counts = or_default(args.sweep_threads, args.threads);
+    const auto queue_sizes = or_default(args.sweep_queue, args.queue);
+    const auto producer_counts = or_default(args.sweep_producers, args.producers);
+    std::vector<size_t> iter_counts = or_default(args.sweep_iters, static_cast<size_t>(args.iters));
+
+    std::cerr << "=== ThreadPool Sweep === jobs=" << args.jobs << " mode=" << args.mode
+              << " warmup=" << args.warmup << " repeats=" << args.repeats << "\n";
+
+    std::vector<SweepPoint> points;
+    for (size_t iters : iter_counts) {
+        for (size_t producers : producer_counts) {
+            for (size_t queue : queue_sizes) {
+                for (size_t threads : thread_counts) {
+                    Args run = args;
+                    run.threads = threads;
+                    run.queue = queue;
+                    run.producers = producers;
+                    run.iters = iters;
+                    for (size_t w = 0; w < args.warmup; ++w) {
+                        measure_throughput(run);
+                    }
+                    std::vector<double> samples;
+                    for (size_t r = 0; r < args.repeats; ++r) {
+                        samples.push_back(measure_throughput(run));
+                    }
+
+                    SweepPoint point{threads, queue, producers, iters};
+                    for (double v : samples) point.mean += v;
+                    point.mean /= samples.size();
+                    for (double v : samples) point.stddev += (v - point.mean) * (v - point.mean);
+                    point.stddev = samples.size() > 1 ? std::sqrt(point.stddev / (samples.size() - 1)) : 0.0;
+                    points.push_back(point);
+                    std::cerr << "  threads=" << threads << " queue=" << queue << " producers=" << producers
+                              << " iters=" << iters << " mean_jobs_per_sec=" << point.mean
+                              << " stddev=" << point.stddev << "\n";
+                }
+            }
+        }
+    }
+
+    const size_t base_threads = *std::min_element(thread_counts.begin(), thread_counts.end());
+    for (auto& point : points) {
+        for (const auto& base : points) {
+            if (base.threads == base_threads && base.queue == point.queue && base.producers == point.producers &&
+                base.iters == point.iters && base.mean > 0) {
+                point.speedup = point.mean / base.mean;
+                point.efficiency = point.speedup * base_threads / point.threads;
+            }
+        }
+    }
+
+    const bool json = args.sweep_format == "json";
+    std::ostringstream out;
+    if (json) {
+        out << "[\n";
+        for (size_t i = 0; i < points.size(); ++i) {
+            const auto& p = points[i];
+            out << "  {\"threads\": " << p.threads << ", \"queue\": " << p.queue << ", \"producers\": " << p.producers
+                << ", \"iters\": " << p.iters << ", \"mean_jobs_per_sec\": " << p.mean
+                << ", \"stddev_jobs_per_sec\": " << p.stddev << ", \"speedup\": " << p.speedup
+                << ", \"efficiency\": " << p.efficiency << "}" << (i + 1 < points.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    } else {
+        out << "threads,queue,producers,iters,mean_jobs_per_sec,stddev_jobs_per_sec,speedup,efficiency\n";
+        for (const auto& p : points) {
+            out << p.threads << "," << p.queue << "," << p.producers << "," << p.iters << "," << p.mean << ","
+                << p.stddev << "," << p.speedup << "," << p.efficiency << "\n";
+        }
+    }
+
+    if (args.sweep_out.empty()) {
+        std::cout << out.str();
+    } else {
+        std::ofstream file(args.sweep_out);
+        if (!file) {
+            std::cerr << "Cannot write " << args.sweep_out << "\n";
+            return 1;
+        }
+        file << out.str();
+        std::cerr << "Wrote " << points.size() << " points to " << args.sweep_out << "\n";
+    }
+    return 0;
+}
+
+// Sleep to just short of the deadline and spin the rest, so timer slack on the load
+// generator side is not charged to the pool.
+static void wait_until(Clock::time_point when) {
+    std::this_thread::sleep_until(when - std::chrono::microseconds(100));
+    while (Clock::now() < when) {
+    }
+}
+
+// One open-loop run. Latency is measured from the time each job was scheduled to be
+// submitted, not from when submit() actually ran: a producer held up by backpressure
+// keeps its schedule and submits the overdue jobs back to back, so the delay it
+// suffered is charged to those jobs (coordinated-omission correction). The *_raw
+// histograms measure from the submit() call, which is what a closed-loop client sees.
+struct OpenLoopLevel {
+    double offered_rate = 0.0;
+    double achieved_rate = 0.0;
+    size_t completed = 0;
+    uint64_t late_submits = 0; // submitted more than 1 ms behind schedule
+    uint64_t shed = 0;         // queued, then dropped by load shedding
+    uint64_t rejected = 0;     // refused at submit by load shedding
+    ShardedHistogram::Snapshot start, finish, start_raw, finish_raw;
+    ShardedHistogram::Snapshot finish_high; // priority-0 jobs only
+    LaneStats lanes;
+};
+
+static OpenLoopLevel run_open_loop(const Args& args, double rate) {
+    ShardedLogHistogram start, finish, start_raw, finish_raw, finish_high;
+    std::atomic<size_t> completed{0};
+    std::atomic<uint64_t> late{0};
+    std::atomic<uint64_t> shed{0};
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint64_t> checksum{0};
+
+    auto nanos = [](Clock::duration d) {
+        return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    };
+
+    LaneOptions lane_options;
+    lane_options.reserved_workers = args.reserve;
+    ThreadPool pool(args.threads, args.queue, {}, lane_options);
+    if (args.shed_target_us > 0) {
+        JobQueue::SheddingOptions shedding;
+        shedding.target = std::chrono::microseconds(args.shed_target_us);
+        pool.set_load_shedding(shedding);
+    }
+    const auto t0 = Clock::now() + std::chrono::milliseconds(1);
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < args.producers; ++p) {
+        producers.emplace_back([&, p]() {
+            const size_t jobs = args.jobs / args.producers + (p < args.jobs % args.producers ? 1 : 0);
+            const double producer_rate = rate / static_cast<double>(args.producers);
+            std::mt19937_64 rng(0x9e3779b97f4a7c15ULL + p);
+            std::exponential_distribution<double> gap(producer_rate);
+            std::uniform_real_distribution<double> share(0.0, 1.0);
+            double offset_s = args.arrival == "poisson" ? gap(rng) : 0.0;
+            for (size_t i = 0; i < jobs; ++i) {
+                const auto intended = t0 + std::chrono::duration_cast<Clock::duration>(
+                                               std::chrono::duration<double>(offset_s));
+                offset_s += args.arrival == "poisson" ? gap(rng) : 1.0 / producer_rate;
+                wait_until(intended);
+
+                const auto submitted = Clock::now();
+                if (submitted - intended > std::chrono::milliseconds(1)) {
+                    late.fetch_add(1, std::memory_order_relaxed);
+                }
+                const bool high = args.high_share > 0.0 && share(rng) < args.high_share;
+                JobMetadata meta(static_cast<int>(i), high ? "bench_open_loop_high" : "bench_open_loop");
+                meta.priority = high ? 0 : 10;
+                meta.allow_retry = false;
+                try {
+                    pool.submit(std::move(meta), [&, intended, submitted, high]() {
+                        const auto began = Clock::now();
+                        start.ObserveNanos(nanos(began - intended));
+                        start_raw.ObserveNanos(nanos(began - submitted));
+                        if (args.mode == "cpu") {
+                            checksum.fetch_add(cpu_work(args.iters), std::memory_order_relaxed);
+                        } else {
+                            std::this_thread::sleep_for(std::chrono::microseconds(args.sleep_us));
+                        }
+                        const auto ended = Clock::now();
+                        finish.ObserveNanos(nanos(ended - intended));
+                        finish_raw.ObserveNanos(nanos(ended - submitted));
+                        if (high) finish_high.ObserveNanos(nanos(ended - intended));
+                        completed.fetch_add(1, std::memory_order_release);
+                    }, [&](std::exception_ptr) { shed.fetch_add(1, std::memory_order_relaxed); });
+                } catch (const std::runtime_error&) {
+                    rejected.fetch_add(1, std::memory_order_relaxed); // refused by load shedding
+                }
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    pool.shutdown(args.shutdown_timeout_s);
+    const double elapsed_s = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    OpenLoopLevel level;
+    level.lanes = pool.lane_stats();
+    level.offered_rate = rate;
+    level.completed = completed.load(std::memory_order_acquire);
+    level.achieved_rate = level.completed / (elapsed_s > 0 ? elapsed_s : 1e-9);
+    level.late_submits = late.load(std::memory_order_relaxed);
+    level.shed = shed.load(std::memory_order_relaxed);
+    level.rejected = rejected.load(std::memory_order_relaxed);
+    level.finish_high = finish_high.snapshot();
+    level.start = start.snapshot();
+    level.finish = finish.snapshot();
+    level.start_raw = start_raw.snapshot();
+    level.finish_raw = finish_raw.snapshot();
+    return level;
+}
+
+static void print_latency(const char* label, const ShardedHistogram::Snapshot& snap) {
+    std::cout << "  " << label
+              << " p50_us=" << snap.quantile(0.50) * 1e6
+              << " p90_us=" << snap.quantile(0.90) * 1e6
+              << " p99_us=" << snap.quantile(0.99) * 1e6
+              << " p999_us=" << snap.quantile(0.999) * 1e6
+              << " mean_us=" << (snap.count ? snap.sum / snap.count * 1e6 : 0.0) << "\n";
+}
+
+static int open_loop_main(const Args& args) {
+    std::cout << "=== ThreadPool Open-Loop Benchmark ===\n";
+    std::cout << "threads=" << args.threads
+              << " queue=" << args.queue
+              << " jobs_per_rate=" << args.jobs
+              << " producers=" << args.producers
+              << " arrival=" << args.arrival
+              << " mode=" << args.mode
+              << (args.mode == "cpu" ? (" iters=" + std::to_string(args.iters))
+                                      : (" sleep_us=" + std::to_string(args.sleep_us)))
+              << " high_share=" << args.high_share
+              << " shed_target_us=" << args.shed_target_us
+              << " reserve=" << args.reserve
+              << "\n";
+    std::cout << "Latency is measured from each job's scheduled submit time (corrected for coordinated omission);\n"
+              << "*_raw is measured from the actual submit() call.\n\n";
+
+    std::vector<OpenLoopLevel> levels;
+    bool all_completed = true;
+    for (double rate : args.rates) {
+        levels.push_back(run_open_loop(args, rate));
+        const OpenLoopLevel& level = levels.back();
+        std::cout << "offered_rate=" << level.offered_rate
+                  << " achieved_rate=" << level.achieved_rate
+                  << " completed=" << level.completed << "/" << args.jobs
+                  << " late_submits=" << level.late_submits
+                  << " shed=" << level.shed << " rejected=" << level.rejected << "\n";
+        print_latency("submit_to_start", level.start);
+        print_latency("submit_to_finish", level.finish);
+        print_latency("submit_to_start_raw", level.start_raw);
+        print_latency("submit_to_finish_raw", level.finish_raw);
+        if (args.high_share > 0.0) {
+            print_latency("submit_to_finish_high", level.finish_high);
+        }
+        if (args.reserve > 0) {
+            for (const auto* lane : {&level.lanes.reserved, &level.lanes.shared}) {
+                std::cout << "  " << (lane == &level.lanes.reserved ? "lane_reserved" : "lane_shared")
+                          << " workers=" << lane->workers << " utilization=" << lane->utilization
+                          << " jobs=" << lane->jobs << " borrowed=" << lane->borrowed
+                          << " mean_wait_us=" << lane->mean_wait_seconds * 1e6
+                          << " max_wait_us=" << lane->max_wait_seconds * 1e6 << "\n";
+            }
+        }
+        all_completed = all_completed && level.completed + level.shed + level.rejected == args.jobs;
+    }
+
+    if (levels.size() > 1) {
+        // The knee is the highest rate that is still keeping up: at least 95% of the offered
+        // rate achieved and corrected p99 within knee_factor of the lowest rate's p99.
+        std::vector<const OpenLoopLevel*> by_rate;
+        for (const auto& level : levels) by_rate.push_back(&level);
+        std::sort(by_rate.begin(), by_rate.end(),
+                  [](const OpenLoopLevel* a, const OpenLoopLevel* b) { return a->offered_rate < b->offered_rate; });
+        const double baseline_p99 = by_rate.front()->finish.quantile(0.99);
+        const OpenLoopLevel* knee = nullptr;
+        for (const OpenLoopLevel* level : by_rate) {
+            const bool keeps_up = level->achieved_rate >= 0.95 * level->offered_rate &&
+                                  level->finish.quantile(0.99) <= args.knee_factor * baseline_p99;
+            if (!keeps_up) break;
+            knee = level;
+        }
+        std::cout << "Sweep:\n";
+        std::cout << "  offered_rate,achieved_rate,p50_us,p99_us,p999_us,p99_raw_us\n";
+        for (const OpenLoopLevel* level : by_rate) {
+            std::cout << "  " << level->offered_rate << "," << level->achieved_rate << ","
+                      << level->finish.quantile(0.50) * 1e6 << "," << level->finish.quantile(0.99) * 1e6 << ","
+                      << level->finish.quantile(0.999) * 1e6 << "," << level->finish_raw.quantile(0.99) * 1e6 << "\n";
+        }
+        if (knee != nullptr) {
+            std::cout << "  saturation_knee_rate=" << knee->offered_rate << "\n";
+        } else {
+            std::cout << "  saturation_knee_rate=none (already saturated at the lowest rate)\n";
+        }
+    }
+
+    if (!all_completed) {
+        std::cerr << "\nWARNING: Not all jobs completed within shutdown timeout.\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Replays a JobRecorder trace: same inter-arrival times (divided by --replay_speed), names,
+// priorities and timeouts, with busy-work spinning for each job's recorded run time.
+// Cancelled jobs are skipped. Compares queue wait, end-to-end latency and deadline misses
+// (expired before running) against what was recorded.
+static int replay_main(const Args& args) {
+    std::vector<JobRecorder::Record> records;
+    try {
+        records = JobRecorder::load(args.replay_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    if (records.empty()) {
+        std::cerr << "Recording is empty: " << args.replay_path << "\n";
+        return 1;
+    }
+
+    ShardedLogHistogram recorded_wait, recorded_e2e, replay_wait, replay_e2e;
+    size_t skipped = 0;
+    uint64_t recorded_misses = 0;
+    for (const auto& r : records) {
+        if (r.flags & JobRecorder::kCancelled) {
+            ++skipped;
+            continue;
+        }
+        if (r.flags & JobRecorder::kExpired) {
+            ++recorded_misses;
+            continue;
+        }
+        recorded_wait.ObserveNanos(r.wait_ns);
+        recorded_e2e.ObserveNanos(r.wait_ns + r.run_ns);
+    }
+
+    std::cout << "=== ThreadPool Replay ===\n";
+    std::cout << "recording=" << args.replay_path << " jobs=" << records.size() - skipped
+              << " skipped_cancelled=" << skipped << " speed=" << args.replay_speed
+              << " threads=" << args.threads << " queue=" << args.queue << "\n\n";
+
+    auto nanos = [](Clock::duration d) {
+        return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    };
+    std::atomic<uint64_t> replay_misses{0};
+    std::atomic<size_t> finished{0};
+    ThreadPool pool(args.threads, args.queue);
+    const auto t0 = Clock::now() + std::chrono::milliseconds(1);
+    const int64_t first_ns = records.front().submit_ns;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const auto& r = records[i];
+        if (r.flags & JobRecorder::kCancelled) continue;
+        const auto intended = t0 + std::chrono::nanoseconds(
+                                       static_cast<int64_t>((r.submit_ns - first_ns) / args.replay_speed));
+        wait_until(intended);
+
+        JobMetadata meta(static_cast<int>(i), r.name);
+        meta.priority = r.priority;
+        meta.timeout = std::chrono::milliseconds(r.timeout_ms);
+        meta.allow_retry = false;
+        const int64_t run_ns = r.run_ns;
+        // Measured from the submit() call, like the recorded wait (JobMetadata::enqueue_time).
+        const auto submitted = Clock::now();
+        pool.submit(std::move(meta),
+                    [&, submitted, run_ns]() {
+                        const auto began = Clock::now();
+                        replay_wait.ObserveNanos(nanos(began - submitted));
+                        while (Clock::now() - began < std::chrono::nanoseconds(run_ns)) {
+                        }
+                        replay_e2e.ObserveNanos(nanos(Clock::now() - submitted));
+                        finished.fetch_add(1, std::memory_order_release);
+                    },
+                    [&](std::exception_ptr) {
+                        replay_misses.fetch_add(1, std::memory_order_relaxed);
+                        finished.fetch_add(1, std::memory_order_release);
+                    });
+    }
+    pool.shutdown(args.shutdown_timeout_s);
+
+    const auto rec_wait = recorded_wait.snapshot(), rec_e2e = recorded_e2e.snapshot();
+    const auto rep_wait = replay_wait.snapshot(), rep_e2e = replay_e2e.snapshot();
+    auto row = [](const char* label, const ShardedHistogram::Snapshot& recorded,
+                  const ShardedHistogram::Snapshot& replayed, double q) {
+        const double a = recorded.quantile(q) * 1e6, b = replayed.quantile(q) * 1e6;
+        std::cout << "  " << label << " recorded_us=" << a << " replay_us=" << b
+                  << " delta_us=" << b - a << "\n";
+    };
+    std::cout << "Results:\n";
+    row("queue_wait_p50", rec_wait, rep_wait, 0.50);
+    row("queue_wait_p99", rec_wait, rep_wait, 0.99);
+    row("end_to_end_p50", rec_e2e, rep_e2e, 0.50);
+    row("end_to_end_p99", rec_e2e, rep_e2e, 0.99);
+    const uint64_t misses = replay_misses.load(std::memory_order_relaxed);
+    std::cout << "  deadline_misses recorded=" << recorded_misses << " replay=" << misses
+              << " delta=" << static_cast<int64_t>(misses) - static_cast<int64_t>(recorded_misses) << "\n";
+
+    if (finished.load(std::memory_order_acquire) != records.size() - skipped) {
+        std::cerr << "\nWARNING: Not all jobs completed within shutdown timeout.\n";
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char** argv) {
     // Reduce logging overhead
     spdlog::set_level(spdlog::level::warn);
 
     const Args args = parse_args(argc, argv);
+    if (!args.record_path.empty()) {
+        try {
+            JobRecorder::instance().start(args.record_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 2;
+        }
+    }
+    if (!args.replay_path.empty() || !args.rates.empty() || args.sweep()) {
+        const int rc = !args.replay_path.empty() ? replay_main(args)
+                     : !args.rates.empty()       ? open_loop_main(args)
+                                                 : sweep_main(args);
+        JobRecorder::instance().stop();
+        return rc;
+    }
+
+    std::shared_ptr<AsyncLogSink> async_log;
+    if (args.log != "off") {
+        spdlog::set_default_logger(spdlog::basic_logger_mt("bench", args.log_file, true));
+        spdlog::set_level(spdlog::level::info);
+        if (args.log == "async") {
+            async_log = install_async_default_logger();
+        }
+    }
 
     std::cout << "=== ThreadPool Benchmark ===\n";
     std::cout << "threads=" << args.threads
               << " queue=" << args.queue
               << " jobs=" << args.jobs
+              << " producers=" << args.producers
               << " mode=" << args.mode
+              << " log=" << args.log
               << (args.mode == "cpu" ? (" iters=" + std::to_string(args.iters))
                                       : (" sleep_us=" + std::to_string(args.sleep_us)))
               << "\n\n";
@@ -174,6 +856,14 @@ int main(int argc, char** argv) {
                   << "us. Short sleeps can be scheduler/timer limited and are not reliable for throughput claims.\n\n";
     }
 
+    if (!args.trace_path.empty()) {
+        JobTracer::instance().enable(args.trace_path, args.trace_events);
+    }
+
+    if (args.profile) {
+        JobProfiler::instance().enable(args.profile_csw);
+    }
+
     ThreadPool pool(args.threads, args.queue);
 
     std::atomic<size_t> completed{0};
@@ -182,26 +872,7 @@ int main(int argc, char** argv) {
     // Submit phase timing
     const auto t_submit_start = Clock::now();
 
-    if (args.mode == "cpu") {
-        for (size_t i = 0; i < args.jobs; ++i) {
-            JobMetadata meta(static_cast<int>(i), "bench_cpu");
-            meta.allow_retry = false;
-            pool.submit(std::move(meta), [&completed, &checksum, iters = args.iters]() {
-                uint64_t v = cpu_work(iters);
-                checksum.fetch_add(v, std::memory_order_relaxed);//don't care about ordering
-                completed.fetch_add(1, std::memory_order_release);
-            });
-        }
-    } else { // sleep
-        for (size_t i = 0; i < args.jobs; ++i) {
-            JobMetadata meta(static_cast<int>(i), "bench_sleep");
-            meta.allow_retry = false;
-            pool.submit(std::move(meta), [&completed, us = args.sleep_us]() {
-                std::this_thread::sleep_for(std::chrono::microseconds(us));
-                completed.fetch_add(1, std::memory_order_release);
-            });
-        }
-    }
+    submit_closed_loop(pool, args, completed, checksum);
 
     const auto t_submit_end = Clock::now();
 
@@ -209,6 +880,14 @@ int main(int argc, char** argv) {
     const auto t_run_start = Clock::now();
     pool.shutdown(args.shutdown_timeout_s);
     const auto t_run_end = Clock::now();
+    JobRecorder::instance().stop();
+    int64_t log_drain_ms = 0;
+    if (async_log) {
+        // Whatever the flusher has not written yet is drained outside the timed region, and reported.
+        const auto t_drain_start = Clock::now();
+        async_log->stop();
+        log_drain_ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t_drain_start).count();
+    }
 
     const auto submit_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t_submit_end - t_submit_start).count();
     const auto post_submit_wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t_run_end - t_run_start).count();
@@ -227,10 +906,54 @@ int main(int argc, char** argv) {
     std::cout << "  total_end_to_end_ms=" << total_ms << "\n";
     std::cout << "  throughput_jobs_per_sec=" << throughput << "\n";
 
+    if (async_log) {
+        std::cout << "  log_dropped=" << async_log->dropped() << " log_drain_ms=" << log_drain_ms << "\n";
+    }
+
     if (submit_ms > total_ms / 2) {
         std::cout << "  note=submission overlaps execution because the bounded queue applies backpressure\n";
     }
 
+    const PoolContentionStats contention_stats = pool.contention_stats();
+    if (contention::kEnabled) {
+        const auto& q = contention_stats.queue;
+        double busy_ratio_sum = 0.0, busy_ratio_min = 1.0, busy_ratio_max = 0.0;
+        for (const auto& w : contention_stats.workers) {
+            busy_ratio_sum += w.busy_ratio();
+            busy_ratio_min = std::min(busy_ratio_min, w.busy_ratio());
+            busy_ratio_max = std::max(busy_ratio_max, w.busy_ratio());
+        }
+        const size_t workers = contention_stats.workers.empty() ? 1 : contention_stats.workers.size();
+        std::cout << "Contention:\n";
+        std::cout << "  lock_acquisitions=" << q.lock_acquisitions
+                  << " contended=" << q.lock_contended
+                  << " (" << (q.lock_acquisitions ? 100.0 * q.lock_contended / q.lock_acquisitions : 0.0) << "%)"
+                  << " lock_wait_ms=" << q.lock_wait_ns / 1e6 << "\n";
+        std::cout << "  producer_waits=" << q.producer_waits
+                  << " producer_block_ms=" << q.producer_block_ns / 1e6 << "\n";
+        std::cout << "  consumer_waits=" << q.consumer_waits
+                  << " consumer_park_ms=" << q.consumer_park_ns / 1e6
+                  << " spurious_wakeups=" << q.spurious_wakeups << "\n";
+        std::cout << "  worker_busy_ratio avg=" << busy_ratio_sum / workers
+                  << " min=" << busy_ratio_min
+                  << " max=" << busy_ratio_max << "\n";
+    } else {
+        std::cout << "Contention: not recorded (configure with -DENABLE_CONTENTION_STATS=ON)\n";
+    }
+
+    if (args.profile) {
+        std::cout << "Job cost profile:\n";
+        JobProfiler::instance().dump_profile(std::cout);
+    }
+
+    if (!args.record_path.empty()) {
+        std::cout << "Recording: " << args.record_path << " (jobs=" << JobRecorder::instance().recorded() << ")\n";
+    }
+
+    if (!args.trace_path.empty()) {
+        std::cout << "Trace: " << args.trace_path << " (dropped_events=" << JobTracer::instance().dropped() << ")\n";
+    }
+
     // Simple sanity warning
     if (completed.load(std::memory_order_acquire) != args.jobs) {
         std::cerr << "\nWARNING: Not all jobs completed within shutdown timeout.\n"
@@ -0,0 +1,369 @@
+// cache_bench.cpp
+// LRUCache throughput / latency benchmark.
+//
+// Each worker thread runs a read/write mix against one shared LRUCache<uint64_t, std::string>:
+// - reads use get_shared() and, on a miss, insert the value (read-through behaviour)
+// - writes overwrite the key with a fresh value of --value_size bytes
+// Key distributions: uniform, zipf (skewed hot set) and scan (sequential sweep, LRU worst case).
+// Reports ops/sec, p50/p99/p999 per-operation latency, hit ratio and RSS; --json writes the
+// same numbers in machine-readable form.
+
+#include "LRUCache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+struct Args {
+    std::vector<size_t> threads = {1, 2, 4, std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 8};
+    size_t capacity = 100000;
+    uint64_t keys = 200000;       // key space size
+    size_t ops = 1000000;         // operations per thread
+    double read_ratio = 0.9;      // fraction of get_shared() calls
+    size_t value_size = 64;       // bytes per value
+    std::string dist = "zipf";    // uniform, zipf or scan
+    double zipf_s = 0.99;
+    bool prefill = true;
+    std::string json_path;
+};
+
+struct Result {
+    size_t threads = 0;
+    double seconds = 0.0;
+    double ops_per_sec = 0.0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t writes = 0;
+    double p50_ns = 0.0;
+    double p99_ns = 0.0;
+    double p999_ns = 0.0;
+    double max_ns = 0.0;
+    size_t rss_bytes = 0;
+};
+
+static void print_usage(const char* exe) {
+    std::cout
+        << "Usage: " << exe << " [options]\n\n"
+        << "Options:\n"
+        << "  --threads LIST      Comma-separated thread counts (default: 1,2,4,hw_concurrency)\n"
+        << "  --capacity N        Cache capacity in entries (default: 100000)\n"
+        << "  --keys N            Key space size (default: 200000)\n"
+        << "  --ops N             Operations per thread (default: 1000000)\n"
+        << "  --read_ratio R      Fraction of reads, 0..1 (default: 0.9)\n"
+        << "  --value_size N      Value size in bytes (default: 64)\n"
+        << "  --dist D            uniform|zipf|scan (default: zipf)\n"
+        << "  --zipf_s S          Zipf exponent (default: 0.99)\n"
+        << "  --no_prefill        Start every run with an empty cache\n"
+        << "  --json FILE         Write results as JSON (use - for stdout)\n"
+        << "  --help              Show this message\n";
+}
+
+static std::vector<size_t> parse_list(const std::string& s) {
+    std::vector<size_t> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        const size_t v = static_cast<size_t>(std::strtoull(item.c_str(), nullptr, 10));
+        if (v > 0) out.push_back(v);
+    }
+    return out;
+}
+
+static Args parse_args(int argc, char** argv) {
+    Args a;
+    for (int i = 1; i < argc; ++i) {
+        const std::string key = argv[i];
+        auto need_value = [&](const char* opt) -> const char* {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << opt << "\n";
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (key == "--help" || key == "-h") {
+            print_usage(argv[0]);
+            std::exit(0);
+        } else if (key == "--threads") {
+            a.threads = parse_list(need_value("--threads"));
+        } else if (key == "--capacity") {
+            a.capacity = static_cast<size_t>(std::strtoull(need_value("--capacity"), nullptr, 10));
+        } else if (key == "--keys") {
+            a.keys = std::strtoull(need_value("--keys"), nullptr, 10);
+        } else if (key == "--ops") {
+            a.ops = static_cast<size_t>(std::strtoull(need_value("--ops"), nullptr, 10));
+        } else if (key == "--read_ratio") {
+            a.read_ratio = std::strtod(need_value("--read_ratio"), nullptr);
+        } else if (key == "--value_size") {
+            a.value_size = static_cast<size_t>(std::strtoull(need_value("--value_size"), nullptr, 10));
+        } else if (key == "--dist") {
+            a.dist = need_value("--dist");
+        } else if (key == "--zipf_s") {
+            a.zipf_s = std::strtod(need_value("--zipf_s"), nullptr);
+        } else if (key == "--no_prefill") {
+            a.prefill = false;
+        } else if (key == "--json") {
+            a.json_path = need_value("--json");
+        } else {
+            std::cerr << "Unknown option: " << key << "\n";
+            print_usage(argv[0]);
+            std::exit(2);
+        }
+    }
+    if (a.threads.empty()) a.threads = {1};
+    if (a.capacity == 0) a.capacity = 1;
+    if (a.ops == 0) a.ops = 1;
+    a.read_ratio = std::min(1.0, std::max(0.0, a.read_ratio));
+    if (a.keys == 0) {
+        std::cerr << "Invalid --keys. Use a key space of at least 1.\n";
+        print_usage(argv[0]);
+        std::exit(2);
+    }
+    if (a.dist != "uniform" && a.dist != "zipf" && a.dist != "scan") {
+        std::cerr << "Invalid --dist. Use uniform, zipf or scan.\n";
+        std::exit(2);
+    }
+    return a;
+}
+
+// Zipf sampler over [0, n): inverse CDF lookup in a precomputed table, shared by all threads.
+class ZipfTable {
+public:
+    ZipfTable(uint64_t n, double s) : cdf_(n) {
+        double sum = 0.0;
+        for (uint64_t i = 0; i < n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), s);
+            cdf_[i] = sum;
+        }
+        for (auto& c : cdf_) c /= sum;
+    }
+
+    uint64_t sample(double u) const {
+        auto it = std::lower_bound(cdf_.begin(), cdf_.end(), u);
+        return it == cdf_.end() ? cdf_.size() - 1 : static_cast<uint64_t>(it - cdf_.begin());
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+static size_t current_rss_bytes() {
+#if defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    size_t pages_total = 0;
+    size_t pages_resident = 0;
+    if (statm >> pages_total >> pages_resident) {
+        return pages_resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
+
+static double percentile(const std::vector<uint32_t>& sorted, double q) {
+    if (sorted.empty()) return 0.0;
+    const size_t idx = std::min(sorted.size() - 1, static_cast<size_t>(q * static_cast<double>(sorted.size())));
+    return sorted[idx];
+}
+
+static Result run(const Args& args, size_t threads, const ZipfTable* zipf) {
+    LRUCache<uint64_t, std::string> cache(args.capacity);
+    const std::string payload(args.value_size, 'x');
+
+    if (args.prefill) {
+        const uint64_t n = std::min<uint64_t>(args.capacity, args.keys);
+        for (uint64_t k = 0; k < n; ++k) {
+            cache.put(k, payload);
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> latencies(threads);
+    std::vector<uint64_t> hits(threads, 0), misses(threads, 0), writes(threads, 0);
+    const int dist = args.dist == "uniform" ? 0 : (args.dist == "zipf" ? 1 : 2);
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false};
+
+    auto worker = [&](size_t t) {
+        std::mt19937_64 rng(0x9e3779b97f4a7c15ULL + t);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::uniform_int_distribution<uint64_t> uniform_key(0, args.keys - 1);
+        uint64_t scan_pos = (args.keys / threads) * t;
+        auto& lat = latencies[t];
+        lat.reserve(args.ops);
+        uint64_t local_hits = 0, local_misses = 0, local_writes = 0; // merged at the end, no false sharing
+
+        ready.fetch_add(1);
+        while (!go.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+
+        for (size_t i = 0; i < args.ops; ++i) {
+            uint64_t key;
+            if (dist == 0) {
+                key = uniform_key(rng);
+            } else if (dist == 1) {
+                key = zipf->sample(unit(rng));
+            } else {
+                key = scan_pos++ % args.keys;
+            }
+            const bool is_read = unit(rng) < args.read_ratio;
+
+            const auto start = Clock::now();
+            if (is_read) {
+                if (cache.get_shared(key)) {
+                    ++local_hits;
+                } else {
+                    ++local_misses;
+                    cache.put(key, payload);
+                }
+            } else {
+                ++local_writes;
+                cache.put(key, payload);
+            }
+            const auto end = Clock::now();
+            lat.push_back(static_cast<uint32_t>(
+                std::min<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(),
+                                  UINT32_MAX)));
+        }
+
+        hits[t] = local_hits;
+        misses[t] = local_misses;
+        writes[t] = local_writes;
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; ++t) {
+        pool.emplace_back(worker, t);
+    }
+    while (ready.load() < threads) {
+        std::this_thread::yield();
+    }
+    const auto t_start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& th : pool) {
+        th.join();
+    }
+    const auto t_end = Clock::now();
+
+    Result r;
+    r.threads = threads;
+    r.seconds = std::chrono::duration<double>(t_end - t_start).count();
+    r.ops_per_sec = static_cast<double>(args.ops * threads) / (r.seconds > 0 ? r.seconds : 1e-9);
+    r.rss_bytes = current_rss_bytes();
+
+    std::vector<uint32_t> all;
+    all.reserve(args.ops * threads);
+    for (size_t t = 0; t < threads; ++t) {
+        r.hits += hits[t];
+        r.misses += misses[t];
+        r.writes += writes[t];
+        all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+    }
+    std::sort(all.begin(), all.end());
+    r.p50_ns = percentile(all, 0.50);
+    r.p99_ns = percentile(all, 0.99);
+    r.p999_ns = percentile(all, 0.999);
+    r.max_ns = all.empty() ? 0.0 : all.back();
+    return r;
+}
+
+static double hit_ratio(const Result& r) {
+    const uint64_t reads = r.hits + r.misses;
+    return reads ? static_cast<double>(r.hits) / static_cast<double>(reads) : 0.0;
+}
+
+static void write_json(std::ostream& out, const Args& args, const std::vector<Result>& results) {
+    out << "{\n"
+        << "  \"benchmark\": \"cache_bench\",\n"
+        << "  \"config\": {"
+        << "\"capacity\": " << args.capacity
+        << ", \"keys\": " << args.keys
+        << ", \"ops_per_thread\": " << args.ops
+        << ", \"read_ratio\": " << args.read_ratio
+        << ", \"value_size\": " << args.value_size
+        << ", \"dist\": \"" << args.dist << "\""
+        << ", \"zipf_s\": " << args.zipf_s
+        << ", \"prefill\": " << (args.prefill ? "true" : "false")
+        << "},\n"
+        << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        out << "    {\"threads\": " << r.threads
+            << ", \"seconds\": " << r.seconds
+            << ", \"ops_per_sec\": " << r.ops_per_sec
+            << ", \"hit_ratio\": " << hit_ratio(r)
+            << ", \"hits\": " << r.hits
+            << ", \"misses\": " << r.misses
+            << ", \"writes\": " << r.writes
+            << ", \"p50_ns\": " << r.p50_ns
+            << ", \"p99_ns\": " << r.p99_ns
+            << ", \"p999_ns\": " << r.p999_ns
+            << ", \"max_ns\": " << r.max_ns
+            << ", \"rss_bytes\": " << r.rss_bytes
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    const Args args = parse_args(argc, argv);
+
+    std::cout << "=== LRUCache Benchmark ===\n";
+    std::cout << "capacity=" << args.capacity
+              << " keys=" << args.keys
+              << " ops/thread=" << args.ops
+              << " read_ratio=" << args.read_ratio
+              << " value_size=" << args.value_size
+              << " dist=" << args.dist
+              << (args.dist == "zipf" ? (" zipf_s=" + std::to_string(args.zipf_s)) : "")
+              << "\n\n";
+
+    std::unique_ptr<ZipfTable> zipf;
+    if (args.dist == "zipf") {
+        zipf = std::make_unique<ZipfTable>(args.keys, args.zipf_s);
+    }
+
+    std::vector<Result> results;
+    for (size_t threads : args.threads) {
+        const Result r = run(args, threads, zipf.get());
+        results.push_back(r);
+
+        std::cout << "threads=" << r.threads << "\n";
+        std::cout << "  ops_per_sec=" << r.ops_per_sec << "\n";
+        std::cout << "  hit_ratio=" << hit_ratio(r) << "\n";
+        std::cout << "  latency_ns p50=" << r.p50_ns << " p99=" << r.p99_ns
+                  << " p999=" << r.p999_ns << " max=" << r.max_ns << "\n";
+        std::cout << "  rss_mb=" << static_cast<double>(r.rss_bytes) / (1024.0 * 1024.0) << "\n";
+    }
+
+    if (!args.json_path.empty()) {
+        if (args.json_path == "-") {
+            write_json(std::cout, args, results);
+        } else {
+            std::ofstream out(args.json_path);
+            if (!out) {
+                std::cerr << "Cannot write " << args.json_path << "\n";
+                return 1;
+            }
+            write_json(out, args, results);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""Compare two Google Benchmark JSON files (micro_bench --benchmark_out_format=json).
+
+Usage: compare_bench.py BASE.json NEW.json [--threshold PCT]
+
+Prints time and throughput per benchmark and the change in time. With --threshold,
+exits with status 1 when any benchmark's time grew by more than PCT percent. When a
+file has repetitions, the median aggregate is used.
+"""
+import argparse
+import json
+import sys
+
+UNIT_NS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    runs = {}
+    medians = {}
+    for b in data.get("benchmarks", []):
+        time_ns = b["real_time"] * UNIT_NS.get(b.get("time_unit", "ns"), 1.0)
+        entry = (time_ns, b.get("items_per_second"))
+        if b.get("run_type") == "aggregate":
+            if b.get("aggregate_name") == "median":
+                medians[b["run_name"]] = entry
+        else:
+            runs.setdefault(b.get("run_name", b["name"]), entry)
+    runs.update(medians)
+    return data.get("context", {}), runs
+
+
+def fmt_time(ns):
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if ns >= scale:
+            return "%.2f %s" % (ns / scale, unit)
+    return "%.1f ns" % ns
+
+
+def fmt_rate(rate):
+    return "-" if rate is None else "%.3gM/s" % (rate / 1e6)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("base")
+    parser.add_argument("new")
+    parser.add_argument("--threshold", type=float, default=None,
+                        help="fail when time grows by more than this percentage")
+    args = parser.parse_args()
+
+    base_ctx, base = load(args.base)
+    new_ctx, new = load(args.new)
+    for label, ctx in (("base", base_ctx), ("new", new_ctx)):
+        print("%s: %s, %s CPUs, %s" % (label, ctx.get("date", "?"), ctx.get("num_cpus", "?"),
+                                       ctx.get("library_build_type", "?")))
+
+    width = max([len(n) for n in base] + [len(n) for n in new] + [9])
+    print("%-*s %12s %12s %9s %11s %11s" % (width, "benchmark", "base", "new", "time", "base_items", "new_items"))
+    regressions = []
+    for name in sorted(set(base) | set(new)):
+        if name not in base or name not in new:
+            print("%-*s %s" % (width, name, "only in " + ("new" if name in new else "base")))
+            continue
+        (b_ns, b_rate), (n_ns, n_rate) = base[name], new[name]
+        delta = (n_ns - b_ns) / b_ns * 100.0 if b_ns > 0 else 0.0
+        print("%-*s %12s %12s %+8.1f%% %11s %11s" % (width, name, fmt_time(b_ns), fmt_time(n_ns), delta,
+                                                   fmt_rate(b_rate), fmt_rate(n_rate)))
+        if args.threshold is not None and delta > args.threshold:
+            regressions.append((name, delta))
+
+    if regressions:
+        print("\n%d benchmark(s) slower than the %.1f%% threshold:" % (len(regressions), args.threshold))
+        for name, delta in regressions:
+            print("  %s %+.1f%%" % (name, delta))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
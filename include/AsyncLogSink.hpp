@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <spdlog/sinks/sink.h>
+#include <spdlog/spdlog.h>
+
+// spdlog sink that hands records to a background flusher through a bounded lock-free ring.
+//
+// log() copies the already formatted payload into a fixed-size slot (longer messages are
+// truncated) and returns; pattern formatting and I/O happen on the flusher thread, which
+// forwards to the wrapped sinks. When the ring is full the record is dropped and counted,
+// never waited for; the flusher reports the number dropped with its next batch.
+class AsyncLogSink : public spdlog::sinks::sink {
+public:
+    static constexpr size_t kMessageBytes = 232;
+    static constexpr size_t kLoggerNameBytes = 24;
+
+    explicit AsyncLogSink(std::vector<spdlog::sink_ptr> sinks, size_t capacity = 8192,
+                          std::chrono::milliseconds idle_sleep = std::chrono::milliseconds(2));
+    ~AsyncLogSink() override;
+
+    void log(const spdlog::details::log_msg& msg) override;
+    void flush() override; // waits until everything logged so far reached the wrapped sinks
+    void set_pattern(const std::string& pattern) override;
+    void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) override;
+
+    void stop(); // drain and join the flusher; later records are dropped
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        spdlog::log_clock::time_point time;
+        size_t thread_id;
+        spdlog::level::level_enum level;
+        uint16_t logger_name_size;
+        uint16_t size;
+        char logger_name[kLoggerNameBytes];
+        char payload[kMessageBytes];
+    };
+
+    bool try_pop(Slot*& slot);
+    void flusher_loop();
+    size_t drain();
+
+    std::vector<spdlog::sink_ptr> sinks_;
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    std::chrono::milliseconds idle_sleep_;
+
+    alignas(64) std::atomic<uint64_t> enqueue_pos_{0};
+    alignas(64) std::atomic<uint64_t> dequeue_pos_{0};
+    alignas(64) std::atomic<uint64_t> dropped_{0};
+    uint64_t reported_dropped_ = 0; // flusher only
+    std::atomic<uint64_t> flushed_pos_{0};
+    std::atomic<bool> running_{true};
+    std::thread flusher_;
+};
+
+// Replace the default logger with one that logs through an AsyncLogSink wrapping the
+// current default logger's sinks. Returns the sink so callers can flush/stop it.
+std::shared_ptr<AsyncLogSink> install_async_default_logger(size_t capacity = 8192);
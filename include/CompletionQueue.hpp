@@ -0,0 +1,204 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+// Results of tagged jobs, collected in completion order instead of one future at a time.
+//
+// ThreadPool::submit_tagged() pushes each job's value, or its terminal exception, together
+// with the caller's tag. Pushes go into a bounded lock-free ring (a full ring spills into a
+// mutex-guarded overflow list, so results are never dropped and workers never block).
+// Callers take completions in batches with drain() or wait(). On Linux, fd() is an
+// eventfd that is readable while completions are pending, for epoll/poll integration;
+// drain() re-arms it. The fd can occasionally be readable with nothing left to drain.
+template <typename T>
+class CompletionQueue {
+    static_assert(!std::is_void_v<T>, "use a value type, e.g. bool, for jobs without a result");
+
+public:
+    struct Completion {
+        uint64_t tag = 0;
+        std::optional<T> value;   // set on success
+        std::exception_ptr error; // set on terminal failure
+
+        bool ok() const { return !error; }
+    };
+
+    explicit CompletionQueue(size_t capacity = 1024) {
+        size_t rounded = 2;
+        while (rounded < capacity) rounded <<= 1;
+        slots_.reset(new Slot[rounded]);
+        mask_ = rounded - 1;
+        for (size_t i = 0; i < rounded; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+#if defined(__linux__)
+        event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (event_fd_ < 0) {
+            throw std::runtime_error("CompletionQueue: eventfd failed");
+        }
+#endif
+    }
+
+    ~CompletionQueue() {
+#if defined(__linux__)
+        if (event_fd_ >= 0) close(event_fd_);
+#endif
+    }
+
+    CompletionQueue(const CompletionQueue&) = delete;
+    CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+    void push(uint64_t tag, T value) {
+        Completion c;
+        c.tag = tag;
+        c.value.emplace(std::move(value));
+        publish(std::move(c));
+    }
+
+    void push_error(uint64_t tag, std::exception_ptr error) {
+        Completion c;
+        c.tag = tag;
+        c.error = std::move(error);
+        publish(std::move(c));
+    }
+
+    // Appends up to max pending completions to out without blocking; returns how many.
+    size_t drain(std::vector<Completion>& out, size_t max = std::numeric_limits<size_t>::max()) {
+        // Consume the eventfd, then clear the flag, then take items. A push that lands
+        // before the flag is cleared is taken below or caught by the check at the end;
+        // one after it signals again. Clearing the flag first would let a push's write
+        // be consumed here while its flag stayed set, and no later push would signal.
+#if defined(__linux__)
+        uint64_t counter = 0;
+        while (read(event_fd_, &counter, sizeof(counter)) < 0 && errno == EINTR) {
+        }
+#endif
+        signaled_.store(false);
+        std::lock_guard<std::mutex> consume(consume_mutex_);
+        size_t taken = 0;
+        while (taken < max && try_pop(out)) ++taken;
+        if (taken < max && overflowed_.load(std::memory_order_acquire) > 0) {
+            std::lock_guard<std::mutex> lock(overflow_mutex_);
+            while (taken < max && !overflow_.empty()) {
+                out.push_back(std::move(overflow_.front()));
+                overflow_.pop_front();
+                overflowed_.fetch_sub(1, std::memory_order_relaxed);
+                ++taken;
+            }
+        }
+        if (!empty()) signal(); // stopped early, or pushed meanwhile; keep fd readable
+        return taken;
+    }
+
+    // drain(), waiting up to timeout for at least one completion.
+    size_t wait(std::vector<Completion>& out, size_t max, std::chrono::milliseconds timeout) {
+        {
+            std::unique_lock<std::mutex> lock(wait_mutex_);
+            wait_cv_.wait_for(lock, timeout, [this]() { return !empty(); });
+        }
+        return drain(out, max);
+    }
+
+    bool empty() const {
+        const uint64_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        return slots_[pos & mask_].sequence.load(std::memory_order_acquire) != pos + 1 &&
+               overflowed_.load(std::memory_order_acquire) == 0;
+    }
+
+    // eventfd readable while completions are pending; -1 where eventfd is unavailable.
+    int fd() const { return event_fd_; }
+
+    uint64_t overflowed_total() const { return overflowed_total_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        Completion completion;
+    };
+
+    // Bounded MPMC ring (Vyukov): a slot whose sequence equals the claim position is free.
+    void publish(Completion c) {
+        uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Slot* slot = nullptr;
+        while (true) {
+            slot = &slots_[pos & mask_];
+            const uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+            const int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                slot = nullptr; // full
+                break;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        if (slot != nullptr) {
+            slot->completion = std::move(c);
+            slot->sequence.store(pos + 1, std::memory_order_release);
+        } else {
+            std::lock_guard<std::mutex> lock(overflow_mutex_);
+            overflow_.push_back(std::move(c));
+            overflowed_.fetch_add(1, std::memory_order_release);
+            overflowed_total_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (!signaled_.exchange(true)) signal();
+    }
+
+    // Caller holds consume_mutex_, so there is one consumer at a time.
+    bool try_pop(std::vector<Completion>& out) {
+        const uint64_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[pos & mask_];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1) return false;
+        out.push_back(std::move(slot.completion));
+        slot.completion = Completion{};
+        slot.sequence.store(pos + mask_ + 1, std::memory_order_release);
+        dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void signal() {
+        signaled_.store(true);
+#if defined(__linux__)
+        const uint64_t one = 1;
+        while (write(event_fd_, &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+#endif
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        wait_cv_.notify_all();
+    }
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<uint64_t> enqueue_pos_{0};
+    alignas(64) std::atomic<uint64_t> dequeue_pos_{0};
+    alignas(64) std::atomic<bool> signaled_{false};
+
+    std::mutex consume_mutex_;
+    std::mutex overflow_mutex_;
+    std::deque<Completion> overflow_;
+    std::atomic<size_t> overflowed_{0};
+    std::atomic<uint64_t> overflowed_total_{0};
+
+    std::mutex wait_mutex_;
+    std::condition_variable wait_cv_;
+    int event_fd_ = -1;
+};
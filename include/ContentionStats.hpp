@@ -0,0 +1,50 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// JobQueue lock / condition-variable contention and per-worker utilization.
+//
+// Compiled in when JOBQUEUE_CONTENTION_STATS is defined (CMake option
+// ENABLE_CONTENTION_STATS, on by default). When it is off, JobQueue locks and waits
+// exactly as before and every field below stays zero.
+namespace contention {
+#ifdef JOBQUEUE_CONTENTION_STATS
+constexpr bool kEnabled = true;
+#else
+constexpr bool kEnabled = false;
+#endif
+
+inline uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+}
+
+// Queue-side counters. JobQueue updates them while holding its mutex, so they need no atomics.
+struct QueueContentionStats {
+    uint64_t lock_acquisitions = 0;
+    uint64_t lock_contended = 0;    // acquisitions where try_lock failed and the caller blocked
+    uint64_t lock_wait_ns = 0;      // time blocked acquiring mutex_ (contended acquisitions only)
+    uint64_t producer_waits = 0;    // push() calls that parked on not_full_cv_
+    uint64_t producer_block_ns = 0;
+    uint64_t consumer_waits = 0;    // pop() calls that parked on not_empty_cv_
+    uint64_t consumer_park_ns = 0;
+    uint64_t spurious_wakeups = 0;  // wakeups from either condition variable whose predicate was still false
+};
+
+struct WorkerUtilization {
+    uint64_t busy_ns = 0; // running jobs and bookkeeping between pops
+    uint64_t idle_ns = 0; // inside JobQueue::pop(), including lock waits and parking
+    uint64_t jobs = 0;
+
+    double busy_ratio() const {
+        const uint64_t total = busy_ns + idle_ns;
+        return total == 0 ? 0.0 : static_cast<double>(busy_ns) / static_cast<double>(total);
+    }
+};
+
+struct PoolContentionStats {
+    QueueContentionStats queue;
+    std::vector<WorkerUtilization> workers;
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "ShardedMetrics.hpp"
+
+// Queue-wait, execution and end-to-end latency histograms labelled by job name and priority.
+//
+// Label cardinality is bounded: at most kMaxJobNames distinct names and kMaxSeries
+// (name, priority) pairs are tracked; anything beyond that is folded into the
+// {job="other", priority="other"} series (index 0). resolve() is called once per
+// submission and stored in JobMetadata::metrics_series, so workers index series
+// directly. Lookups compare the priority and then the name bytes against a small
+// append-only table (with a per-thread last-hit cache) and never hash strings.
+class JobLatencyMetrics {
+public:
+    static constexpr size_t kMaxJobNames = 16;
+    static constexpr size_t kMaxSeries = 64;
+
+    struct Series {
+        std::string job;
+        std::string priority_label;
+        int priority = 0;
+        ShardedLogHistogram queue_wait;
+        ShardedLogHistogram execution;
+        ShardedLogHistogram end_to_end;
+    };
+
+    JobLatencyMetrics();
+
+    int resolve(const std::string& name, int priority);
+
+    size_t size() const { return count_.load(std::memory_order_acquire); }
+    const Series& series(size_t index) const { return *series_[index]; }
+
+    ShardedLogHistogram& queue_wait(int index) { return series_[checked(index)]->queue_wait; }
+    ShardedLogHistogram& execution(int index) { return series_[checked(index)]->execution; }
+    ShardedLogHistogram& end_to_end(int index) { return series_[checked(index)]->end_to_end; }
+
+private:
+    size_t checked(int index) const {
+        return index > 0 && static_cast<size_t>(index) < size() ? static_cast<size_t>(index) : 0;
+    }
+    int find(const std::string& name, int priority, size_t limit) const;
+
+    std::unique_ptr<Series> series_[kMaxSeries];
+    std::atomic<size_t> count_{0};
+    std::mutex append_mutex_;
+    size_t job_names_ = 0;
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <spdlog/spdlog.h>
+
+// Per-job log statements (one or more per submitted job) go through these macros so they
+// can be compiled out entirely. JOBQUEUE_JOB_LOG_LEVEL uses the SPDLOG_LEVEL_* numbers and
+// is set by the CMake cache variable JOB_LOG_LEVEL; statements below it expand to nothing,
+// including their arguments. Messages that are not per job keep calling spdlog directly.
+#ifndef JOBQUEUE_JOB_LOG_LEVEL
+#define JOBQUEUE_JOB_LOG_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+
+#if JOBQUEUE_JOB_LOG_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define JOB_LOG_DEBUG(...) spdlog::debug(__VA_ARGS__)
+#else
+#define JOB_LOG_DEBUG(...) (void)0
+#endif
+
+#if JOBQUEUE_JOB_LOG_LEVEL <= SPDLOG_LEVEL_INFO
+#define JOB_LOG_INFO(...) spdlog::info(__VA_ARGS__)
+#else
+#define JOB_LOG_INFO(...) (void)0
+#endif
+
+#if JOBQUEUE_JOB_LOG_LEVEL <= SPDLOG_LEVEL_WARN
+#define JOB_LOG_WARN(...) spdlog::warn(__VA_ARGS__)
+#else
+#define JOB_LOG_WARN(...) (void)0
+#endif
+
+#if JOBQUEUE_JOB_LOG_LEVEL <= SPDLOG_LEVEL_ERROR
+#define JOB_LOG_ERROR(...) spdlog::error(__VA_ARGS__)
+#else
+#define JOB_LOG_ERROR(...) (void)0
+#endif
@@ -3,6 +3,7 @@
 #include <string>
 #include <chrono>
 #include <atomic>
+#include <cstdint>
 
 struct JobMetadata {
     int id = -1;
@@ -18,6 +19,14 @@ struct JobMetadata {
     std::atomic<bool> cancel_requested{false};
     bool allow_retry = true;
     int priority = 10;
+    int metrics_series = -1; // latency label series, resolved once on submit
+    uint64_t trace_id = 0;   // JobTracer id, assigned on submit while tracing
+    bool blocking = false;   // whole task runs in a ThreadPool::BlockingSection
+    uint64_t strand_key = 0; // nonzero: run after earlier jobs with this key, one at a time
+    uint64_t coalesce_key = 0; // nonzero: fold into a queued job with the same key
+    uint64_t batch_key = 0;    // nonzero: run with other queued jobs of this key in one handler call
+    uint64_t handle = 0;       // nonzero: lets reprioritize() find the job while it is queued
+    uint64_t group = 0;        // nonzero: reprioritize_group() moves all queued jobs of the group
 
     JobMetadata() = default;
 
@@ -40,7 +49,15 @@ struct JobMetadata {
           retry_max_backoff(other.retry_max_backoff),
           retry_jitter_factor(other.retry_jitter_factor),
           allow_retry(other.allow_retry),
-          priority(other.priority) {
+          priority(other.priority),
+          metrics_series(other.metrics_series),
+          trace_id(other.trace_id),
+          blocking(other.blocking),
+          strand_key(other.strand_key),
+          coalesce_key(other.coalesce_key),
+          batch_key(other.batch_key),
+          handle(other.handle),
+          group(other.group) {
         cancel_requested.store(other.cancel_requested.load());
     }
 
@@ -59,6 +76,14 @@ struct JobMetadata {
             retry_jitter_factor = other.retry_jitter_factor;
             allow_retry = other.allow_retry;
             priority = other.priority; 
+            metrics_series = other.metrics_series;
+            trace_id = other.trace_id;
+            blocking = other.blocking;
+            strand_key = other.strand_key;
+            coalesce_key = other.coalesce_key;
+            batch_key = other.batch_key;
+            handle = other.handle;
+            group = other.group;
             cancel_requested.store(other.cancel_requested.load());
         }
         return *this;
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ShardedMetrics.hpp"
+
+// Per-job CPU cost accounting, aggregated per job name.
+//
+// While enabled, workers read the thread CPU clock (CLOCK_THREAD_CPUTIME_ID) and,
+// optionally, the thread's context-switch counts (getrusage(RUSAGE_THREAD), Linux) around
+// every job.task() call, failed attempts included. Samples go to sharded per-name cells,
+// so recording takes no lock. At most kMaxJobNames names are tracked; the rest are
+// reported as "other". While disabled, the hook costs one relaxed atomic load.
+class JobProfiler {
+public:
+    static constexpr size_t kMaxJobNames = 32;
+
+    struct Sample {
+        int64_t wall_ns = 0;
+        int64_t cpu_ns = 0;
+        int64_t voluntary_switches = 0;
+        int64_t involuntary_switches = 0;
+        bool switches_sampled = false;
+    };
+
+    struct Profile {
+        std::string job;
+        ShardedHistogram::Snapshot cpu; // seconds, log-linear buckets; count/sum are totals
+        double wall_seconds = 0.0;
+        uint64_t voluntary_switches = 0;
+        uint64_t involuntary_switches = 0;
+    };
+
+    static JobProfiler& instance();
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    void enable(bool context_switches = false);
+    void disable();
+    bool context_switches() const { return context_switches_.load(std::memory_order_relaxed); }
+
+    // Snapshot of the calling thread's clocks; pass it to record() after the task.
+    Sample begin() const;
+    void record(const std::string& job, const Sample& before);
+
+    // Per-name totals for names with at least one sample, highest CPU first.
+    std::vector<Profile> profile() const;
+
+    // Human-readable cost table: count, CPU total/mean/p99, CPU share, CPU/wall, switches.
+    void dump_profile(std::ostream& out) const;
+
+private:
+    struct Slot {
+        std::string job;
+        ShardedLogHistogram cpu;
+        ShardedCounter wall_ns;
+        ShardedCounter voluntary;
+        ShardedCounter involuntary;
+    };
+
+    JobProfiler();
+    size_t resolve(const std::string& job);
+
+    static inline std::atomic<bool> enabled_{false};
+    std::atomic<bool> context_switches_{false};
+
+    std::unique_ptr<Slot> slots_[kMaxJobNames + 1]; // slot 0 is "other"
+    std::atomic<size_t> count_{0};
+    std::mutex append_mutex_;
+};
@@ -2,17 +2,30 @@
 
 #include <vector>
 #include <algorithm>
+#include <chrono>
 #include <mutex>
 #include <condition_variable> //let threads wait for jobs to become available (or for shutdown)
 #include <exception>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include "ContentionStats.hpp"
 #include "JobMetadata.hpp"
 class JobQueue {
 public:
+    // Result state that callers coalesced into one job share (see ThreadPool::submit_coalesced).
+    struct SharedState {
+        virtual ~SharedState() = default;
+    };
+
     struct Job {
         JobMetadata metadata;
         std::function<void()> task;
         std::function<void(std::exception_ptr)> on_terminal_failure;
+        std::shared_ptr<SharedState> shared_state;
 
         Job() = default;
 
@@ -24,27 +37,150 @@ public:
               on_terminal_failure(std::move(failure_handler)) {}
     };
 
+    // What push() does once the queue is full and the deadline has passed.
+    enum class OverflowPolicy {
+        Block,         // keep the job out (push with no deadline waits for room)
+        Reject,        // keep the job out without waiting
+        DropOldest,    // evict the oldest of the lowest-priority queued jobs; keep the
+                       // new job out only if it is strictly lower priority than all of them
+        DisplaceLower, // evict that job only if it is strictly lower priority than the new one
+    };
+
+    // Merged: the job's coalesce_key matched a queued job, which took the job's priority
+    // and deadline if they were more urgent and chained its failure handler. The job
+    // itself is not queued; its shared_state is set to the queued job's.
+    enum class PushStatus { Ok, Full, Timeout, Shutdown, Overloaded, Merged };
+
+    // Controlled-delay (CoDel) load shedding, off while target is zero. Sheddable jobs are
+    // those at or below shed_priority (numerically >=). Once the queue wait of popped
+    // sheddable jobs has stayed above target for a whole interval, pop(&shed) evicts the
+    // oldest of the lowest-priority queued jobs, again after interval/sqrt(n) for the n-th
+    // eviction while the wait stays high, and push() refuses new sheddable jobs. The first
+    // sheddable pop below target ends it.
+    struct SheddingOptions {
+        std::chrono::microseconds target{0};
+        std::chrono::milliseconds interval{100};
+        int shed_priority = 5;
+    };
+
+    // Micro-batching for one batch key: take_batch() hands a worker up to max_size queued
+    // jobs of the key at once, waiting until the first one has been queued for linger
+    // if fewer are there. The worker lingers only while no other job is queued or another
+    // worker is idle in pop(), so a batch never holds unrelated work back.
+    struct BatchOptions {
+        size_t max_size = 32;
+        std::chrono::microseconds linger{0};
+    };
+
     explicit JobQueue(size_t max_size = 100); 
 
-    bool push(Job job); 
-    Job pop();  // Blocks until job is available
+    bool push(Job job); // blocks while full; false once shut down
+    // Waits for room until deadline (not at all if it has passed), then applies policy.
+    // job is moved from only on Ok; a job evicted to make room is moved into evicted.
+    // A first attempt with a coalesce_key already queued is merged without waiting.
+    PushStatus push(Job& job, std::chrono::steady_clock::time_point deadline, OverflowPolicy policy,
+                    std::optional<Job>& evicted);
+    // Admits job like push() but only takes a slot for it: the job stays with the caller
+    // (a strand job held outside the queue) and counts against max_size until requeue()
+    // or release(). Never merges; job is not moved from.
+    PushStatus reserve(Job& job, std::chrono::steady_clock::time_point deadline, OverflowPolicy policy,
+                       std::optional<Job>& evicted);
+    // Pushes a job into the slot reserve() took for it, without waiting. job is moved from
+    // only on success; false once shut down. Either way the reservation is used up.
+    bool requeue(Job& job);
+    void release(); // gives back a reserve()d slot whose job will not be queued
+    Job pop(std::vector<Job>* shed = nullptr);  // Blocks until job is available; shedding needs shed
+    // pop() for a reserved worker (see WorkerLanes.hpp): takes the top job only if its
+    // priority is <= the lane's max_priority, or to borrow while at least min_idle other
+    // lane workers are waiting here. Returns the shutdown job once shut down and nothing is
+    // left that it may take.
+    Job pop_lane(std::vector<Job>* shed = nullptr);
+    void configure_lane(int max_priority, size_t min_idle);
     bool try_pop(Job& job); // retrieve a job without waiting. 
     bool empty();
     void shutdown();
     bool is_shutdown();
+    QueueContentionStats contention(); // all zero unless built with JOBQUEUE_CONTENTION_STATS
+    void set_shedding(SheddingOptions options);
+    void set_batching(uint64_t batch_key, BatchOptions options);
+    // batch holds one popped job with a batch_key; appends more queued jobs of that key,
+    // highest priority and oldest first, up to the key's max_size. Only jobs with priority
+    // <= max_priority are taken, so a reserved lane worker keeps to its lane.
+    void take_batch(std::vector<Job>& batch, int max_priority = std::numeric_limits<int>::max());
+    // Changes the priority of the queued job with this handle in place: it keeps its
+    // enqueue_time, so it lands behind older jobs of its new priority. O(log n) through
+    // the handle index. False if no job with the handle is queued (running, done, or held
+    // in a strand). Handles must be unique among queued jobs.
+    bool reprioritize(uint64_t handle, int priority);
+    // Every queued job of the group: one pass and one heap rebuild, O(n). Returns how many.
+    size_t reprioritize_group(uint64_t group, int priority);
+    bool shedding(); // queue wait has been above target for an interval
 
 private:
     struct JobCompare {
+        // FIFO within a priority, so queue wait (and shedding on it) tracks arrival order.
         bool operator()(const Job& lhs, const Job& rhs) const {
-            return lhs.metadata.priority > rhs.metadata.priority;
+            if (lhs.metadata.priority != rhs.metadata.priority) {
+                return lhs.metadata.priority > rhs.metadata.priority;
+            }
+            return lhs.metadata.enqueue_time > rhs.metadata.enqueue_time;
         }
     };
 
+    std::unique_lock<std::mutex> acquire(); // locks mutex_, timing it when contended
+    PushStatus push_impl(Job& job, std::chrono::steady_clock::time_point deadline, OverflowPolicy policy,
+                         std::optional<Job>& evicted, bool admission, bool reserving);
+    std::vector<Job>::iterator lowest_priority_oldest();
+    // Heap maintenance by hand instead of std::push_heap/pop_heap, so every move of a job
+    // with a handle updates positions_. All need mutex_ held.
+    Job take_at(size_t index);
+    void sift_up(size_t index);
+    void sift_down(size_t index);
+    void place(size_t index);
+    void heapify();
+    void insert(Job& job); // caller holds mutex_
+    bool merge_queued(Job& job);
+    void remember(const Job& job); // indexes by key as the job enters the queue
+    void forget(const Job& job);   // and undoes it as the job leaves
+    bool sheddable(const Job& job) const;
+    void track_sheddable(const Job& job);
+    void untrack_sheddable(const Job& job);
+    Job take_top(std::vector<Job>* shed);
+    bool evict_for(const Job& incoming, OverflowPolicy policy, std::optional<Job>& evicted);
+    void control_delay(const Job& popped, std::vector<Job>& shed);
+    void recheck_dropping(std::chrono::steady_clock::time_point now);
+
     std::mutex mutex_;
     std::condition_variable not_empty_cv_;// consumer wait
     std::condition_variable not_full_cv_;   // producer wait when full
+    std::condition_variable lane_cv_;       // reserved-worker wait
+    std::condition_variable batch_cv_;      // take_batch() linger wait
     bool shutdown_ = false;
     size_t max_queue_size_;       
-    std::vector<Job> queue_;
+    std::vector<Job> queue_; // binary heap on compare_
+    size_t reserved_ = 0;    // slots held by reserve() for jobs outside queue_
     JobCompare compare_;
+    std::unordered_map<uint64_t, size_t> positions_; // handle -> index in queue_
+    QueueContentionStats stats_; // guarded by mutex_
+    // Queued first attempts per coalesce key. A count, not a set: a strand job requeued
+    // without merging can sit next to another job of its key.
+    std::unordered_map<uint64_t, size_t> coalescing_;
+
+    int lane_max_priority_ = 0;
+    size_t lane_min_idle_ = 1;
+    size_t lane_waiting_ = 0; // reserved workers inside pop_lane()
+
+    std::unordered_map<uint64_t, BatchOptions> batching_;
+    size_t batch_waiting_ = 0; // workers lingering in take_batch()
+    size_t pop_waiting_ = 0;   // workers parked in pop(), free to take any job
+    std::unordered_map<uint64_t, size_t> batch_queued_; // queued jobs per batch key
+
+    // CoDel state, guarded by mutex_.
+    SheddingOptions shedding_;
+    std::chrono::steady_clock::time_point first_above_{}; // unset while below target
+    std::chrono::steady_clock::time_point drop_next_{};
+    // enqueue_time of every queued job sheddable() holds, oldest first; empty while disabled.
+    std::multiset<std::chrono::steady_clock::time_point> sheddable_enqueued_;
+    bool dropping_ = false;
+    uint32_t drop_count_ = 0;
 };
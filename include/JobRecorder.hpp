@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "JobMetadata.hpp"
+
+// Records submitted jobs to a compact binary trace that bench --replay can regenerate.
+//
+// One record per job, written when its first attempt ends (or when it is dropped before
+// running): submit time, priority, timeout, name, queue wait and run time of that attempt,
+// plus whether it expired, was cancelled or failed. Retries are not recorded separately.
+// Records are appended under a mutex through a buffered file, so recording is for
+// capture runs, not for always-on use. While disabled, the hook costs one relaxed load.
+//
+// File layout: "JQREC1\n" then a stream of entries, all integers LEB128 varints:
+//   0 id len bytes                 defines job name `id`
+//   1 dt prio timeout name wait run flags
+// dt is the zigzag delta of submit_ns from the previous job record (records are in
+// completion order, so it can be negative); prio is zigzag; timeout is in milliseconds.
+class JobRecorder {
+public:
+    enum Flags : uint8_t { kExpired = 1, kCancelled = 2, kFailed = 4 };
+
+    struct Record {
+        int64_t submit_ns = 0; // since start()
+        int priority = 10;
+        int64_t timeout_ms = 0;
+        std::string name;
+        int64_t wait_ns = 0;   // submit to first attempt start
+        int64_t run_ns = 0;    // duration of the first attempt; 0 if it never ran
+        uint8_t flags = 0;
+    };
+
+    static JobRecorder& instance();
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // Start recording to path, replacing it. Throws std::runtime_error if it cannot be opened.
+    void start(const std::string& path);
+    void stop(); // flush and close; safe to call when not recording
+
+    void record(const JobMetadata& metadata, std::chrono::steady_clock::time_point started, int64_t run_ns,
+                uint8_t flags);
+
+    uint64_t recorded() const { return recorded_.load(std::memory_order_relaxed); }
+
+    // Read a trace written by start()/stop(), sorted by submit time. Throws on a malformed file.
+    static std::vector<Record> load(const std::string& path);
+
+private:
+    JobRecorder() = default;
+    void put_varint(uint64_t value);
+
+    static inline std::atomic<bool> enabled_{false};
+
+    std::mutex mutex_;
+    std::FILE* file_ = nullptr;
+    std::chrono::steady_clock::time_point epoch_;
+    int64_t last_submit_ns_ = 0;
+    std::unordered_map<std::string, uint64_t> names_;
+    std::atomic<uint64_t> recorded_{0};
+};
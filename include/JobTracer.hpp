@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "JobMetadata.hpp"
+
+// Job lifecycle tracing, exported as Chrome trace event JSON (open in ui.perfetto.dev or
+// chrome://tracing).
+//
+// Every thread records into its own fixed-size ring, so recording takes no lock and
+// memory is bounded: a ring keeps the newest events_per_thread events, and at most
+// kMaxThreads rings are created (events from further threads are counted as dropped).
+// While tracing is disabled, record() costs one relaxed atomic load.
+class JobTracer {
+public:
+    // Start..Finish/Fail/Retry bracket one attempt on a worker; Finish, Fail, Expire, Cancel
+    // and Abort (retry dropped during shutdown) end the job.
+    enum class Phase : uint8_t { Submit, Enqueue, Pop, Start, Finish, Fail, Retry, Expire, Cancel, Abort };
+
+    static constexpr size_t kMaxThreads = 256;
+    static constexpr size_t kNameBytes = 24;
+
+    struct Event {
+        uint64_t ts_ns;
+        uint64_t trace_id;
+        int job_id;
+        int priority;
+        uint16_t attempt;
+        Phase phase;
+        char name[kNameBytes]; // truncated job name, NUL terminated
+    };
+
+    static JobTracer& instance();
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // Start recording. events_per_thread is rounded up to a power of two. When
+    // output_path is set, ThreadPool::shutdown() writes the trace there.
+    void enable(const std::string& output_path = "", size_t events_per_thread = 1 << 16);
+    void disable();
+
+    void record(Phase phase, const JobMetadata& metadata) {
+        if (enabled()) record_slow(phase, metadata);
+    }
+
+    // Unique id linking one job's events across threads; assigned on submit.
+    uint64_t next_trace_id() { return next_trace_id_.fetch_add(1, std::memory_order_relaxed); }
+
+    // Write everything currently buffered as Chrome trace JSON. Safe while threads record.
+    void dump(const std::string& path);
+    void dump_if_configured(); // dump to the enable() path, if any
+
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    struct Ring;
+
+private:
+    JobTracer() = default;
+    void record_slow(Phase phase, const JobMetadata& metadata);
+    Ring* local_ring();
+
+    static inline std::atomic<bool> enabled_{false};
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Ring>> rings_;
+    std::string output_path_;
+    size_t capacity_ = 1 << 16;
+    std::atomic<uint64_t> next_trace_id_{1};
+    std::atomic<uint64_t> dropped_{0};
+    uint64_t epoch_ns_ = 0;
+};
@@ -1,57 +1,198 @@
 #pragma once
+#include <atomic>
 #include <unordered_map>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Key type used for lookups. std::string caches are probed with a string_view
+// (map keys point at the string owned by the list node), so callers holding a
+// literal or a view don't have to build a temporary std::string.
+template <typename Key>
+struct LRUCacheKeyTraits {
+    using lookup_type = Key;
+    static const Key& view(const Key& key) { return key; }
+};
+
+template <>
+struct LRUCacheKeyTraits<std::string> {
+    using lookup_type = std::string_view;
+    static std::string_view view(const std::string& key) { return key; }
+};
 
 template <typename Key, typename Value>
 class LRUCache {
 public:
+    using LookupKey = typename LRUCacheKeyTraits<Key>::lookup_type;
+    using ValuePtr = std::shared_ptr<const Value>;
+
     explicit LRUCache(size_t capacity) : capacity_(capacity) {}
 
     // Get value by key. Returns true if found.
-    bool get(const Key& key, Value& value) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = cache_items_map_.find(key);
-        if (it == cache_items_map_.end()) return false;
-
-        // Move accessed item to front
-        cache_items_list_.splice(cache_items_list_.begin(), cache_items_list_, it->second);
-        value = it->second->second;
+    bool get(const LookupKey& key, Value& value) {
+        ValuePtr found = get_shared(key);
+        if (!found) return false;
+        value = *found; // copy happens outside the lock
         return true;
     }
 
+    // Get a shared handle to the cached value without copying it. Returns nullptr on miss.
+    // The handle stays valid after the entry is overwritten or evicted.
+    ValuePtr get_shared(const LookupKey& key) {
+        std::shared_ptr<Backing> backing;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = cache_items_map_.find(key);
+            if (it != cache_items_map_.end()) {
+                // Move accessed item to front
+                cache_items_list_.splice(cache_items_list_.begin(), cache_items_list_, it->second);
+                return it->second->second;
+            }
+            backing = backing_;
+        }
+
+        if (!backing) return nullptr;
+        ValuePtr restored = backing->take(key);
+        if (!restored) {
+            detach_if_drained(backing);
+            return nullptr;
+        }
+        // A concurrent put wins over the restored value.
+        return insert(Key(key), std::move(restored), false);
+    }
+
     // Insert or update
     void put(const Key& key, const Value& value) {
+        insert(Key(key), std::make_shared<const Value>(value));
+    }
+
+    void put(Key key, Value&& value) {
+        insert(std::move(key), std::make_shared<const Value>(std::move(value)));
+    }
+
+    // Insert an already shared value, e.g. one handle fanned out to several caches or waiters.
+    void put_shared(Key key, ValuePtr value) {
+        if (!value) return;
+        insert(std::move(key), std::move(value));
+    }
+
+    // Construct the value in place from args.
+    template <typename... Args>
+    void emplace(Key key, Args&&... args) {
+        insert(std::move(key), std::make_shared<const Value>(std::forward<Args>(args)...));
+    }
+
+    // Optional: check if key exists
+    bool exists(const LookupKey& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return cache_items_map_.count(key) > 0;
+    }
+
+    size_t size() {
         std::lock_guard<std::mutex> lock(mutex_);
-        auto it = cache_items_map_.find(key);
+        return cache_items_list_.size();
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    // Copy of all entries, most recently used first. Values are shared, not copied.
+    std::vector<std::pair<Key, ValuePtr>> entries() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::vector<std::pair<Key, ValuePtr>>(cache_items_list_.begin(), cache_items_list_.end());
+    }
+
+    // Read-through source consulted on a miss, e.g. a warm-start snapshot (LRUCacheSnapshot).
+    // take() hands each stored value out at most once; forget() is called on every put so
+    // an overwritten key is never resurrected from the backing. Both run outside the cache
+    // lock. Once drained() reports every value handed out, the cache drops the backing.
+    class Backing {
+    public:
+        virtual ~Backing() = default;
+        virtual ValuePtr take(const LookupKey& key) = 0;
+        virtual void forget(const LookupKey& key) = 0;
+        virtual bool drained() const { return false; }
+    };
+
+    void set_backing(std::shared_ptr<Backing> backing) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        backed_.store(backing != nullptr, std::memory_order_relaxed);
+        backing_ = std::move(backing);
+    }
+
+    // Insert only if the key is absent. Returns the resident value either way.
+    ValuePtr put_if_absent(Key key, ValuePtr value) {
+        if (!value) return nullptr;
+        return insert(std::move(key), std::move(value), false);
+    }
+
+private:
+    using Entry = std::pair<Key, ValuePtr>;
+    using Traits = LRUCacheKeyTraits<Key>;
+
+    ValuePtr insert(Key&& key, ValuePtr value, bool overwrite = true) {
+        if (overwrite && backed_.load(std::memory_order_relaxed)) {
+            forget_backed(Traits::view(key));
+        }
+        // Declared before the lock so replaced/evicted values are destroyed after it is released.
+        ValuePtr replaced;
+        std::list<Entry> evicted;
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = cache_items_map_.find(Traits::view(key));
         if (it != cache_items_map_.end()) {
             // Update and move to front
-            it->second->second = value;
+            if (overwrite) {
+                replaced = std::exchange(it->second->second, std::move(value));
+            }
             cache_items_list_.splice(cache_items_list_.begin(), cache_items_list_, it->second);
-            return;
+            return it->second->second;
         }
 
+        if (capacity_ == 0) return value;
+
         // Evict if needed
         if (cache_items_list_.size() == capacity_) {
             auto last = cache_items_list_.end();
             --last;
-            cache_items_map_.erase(last->first);
-            cache_items_list_.pop_back();
+            cache_items_map_.erase(Traits::view(last->first));
+            evicted.splice(evicted.begin(), cache_items_list_, last);
         }
 
-        cache_items_list_.emplace_front(key, value);
-        cache_items_map_[key] = cache_items_list_.begin();
+        cache_items_list_.emplace_front(std::move(key), std::move(value));
+        cache_items_map_.emplace(Traits::view(cache_items_list_.front().first), cache_items_list_.begin());
+        return cache_items_list_.front().second;
     }
 
-    // Optional: check if key exists
-    bool exists(const Key& key) {
+    // Before insert() takes the lock: a take() racing with it loses, since its restored
+    // value is inserted without overwriting.
+    void forget_backed(const LookupKey& key) {
+        std::shared_ptr<Backing> backing;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            backing = backing_;
+        }
+        if (!backing) return;
+        backing->forget(key);
+        detach_if_drained(backing);
+    }
+
+    void detach_if_drained(const std::shared_ptr<Backing>& backing) {
+        if (!backing->drained()) return;
+        std::shared_ptr<Backing> detached; // released after the lock
         std::lock_guard<std::mutex> lock(mutex_);
-        return cache_items_map_.count(key) > 0;
+        if (backing_ != backing) return;
+        detached = std::move(backing_);
+        backed_.store(false, std::memory_order_relaxed);
     }
 
-private:
-    std::list<std::pair<Key, Value>> cache_items_list_;
-    std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator> cache_items_map_;
+    std::list<Entry> cache_items_list_;
+    std::unordered_map<LookupKey, typename std::list<Entry>::iterator> cache_items_map_;
     size_t capacity_;
+    std::shared_ptr<Backing> backing_;
+    std::atomic<bool> backed_{false}; // backing_ != nullptr, read without the lock by puts
     std::mutex mutex_;
-};
\ No newline at end of file
+};
@@ -0,0 +1,283 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "LRUCache.hpp"
+#include "MappedFile.hpp"
+
+// Byte encoding used by snapshots. Trivially copyable types are stored as raw bytes;
+// specialize SnapshotCodec<T> for anything else (std::string is provided).
+template <typename T>
+struct SnapshotCodec {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Specialize SnapshotCodec<T> for types that are not trivially copyable");
+
+    static void encode(const T& value, std::string& out) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static T decode(std::string_view bytes) {
+        if (bytes.size() != sizeof(T)) {
+            throw std::runtime_error("Snapshot record has unexpected size");
+        }
+        T value;
+        std::memcpy(&value, bytes.data(), sizeof(T));
+        return value;
+    }
+};
+
+template <>
+struct SnapshotCodec<std::string> {
+    static void encode(std::string_view value, std::string& out) { out.append(value); }
+    static std::string decode(std::string_view bytes) { return std::string(bytes); }
+};
+
+// On-disk layout (native endianness, meant for warm restarts on the same host class):
+//   Header | records, least recently used first | hash index (open addressing)
+// A record is {u32 key_size, u32 value_size, key bytes, value bytes}. The index maps
+// FNV-1a(key bytes) to record offsets so a lookup touches one slot and one record.
+namespace lru_snapshot {
+constexpr char kMagic[8] = {'L', 'R', 'U', 'S', 'N', 'A', 'P', '\0'};
+constexpr uint32_t kVersion = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t slot_count;
+    uint64_t index_offset;
+};
+
+struct Slot {
+    uint64_t hash;
+    uint64_t offset;  // 0 = empty slot (records never start at offset 0)
+    uint64_t ordinal; // record number, LRU first
+};
+
+inline uint64_t hash_bytes(std::string_view bytes) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : bytes) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+template <typename T>
+T read_pod(const char* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+}
+
+// Writes every entry of cache to path, least recently used first, replacing the file atomically.
+template <typename Key, typename Value>
+void save_snapshot(LRUCache<Key, Value>& cache, const std::string& path) {
+    using namespace lru_snapshot;
+    auto entries = cache.entries(); // most recently used first
+
+    uint64_t slot_count = 1;
+    while (slot_count < entries.size() * 2) slot_count <<= 1;
+    std::vector<Slot> slots(slot_count, Slot{0, 0, 0});
+
+    std::string out(sizeof(Header), '\0');
+    std::string key_bytes;
+    std::string value_bytes;
+    uint64_t ordinal = 0;
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it, ++ordinal) {
+        key_bytes.clear();
+        value_bytes.clear();
+        SnapshotCodec<Key>::encode(it->first, key_bytes);
+        SnapshotCodec<Value>::encode(*it->second, value_bytes);
+        if (key_bytes.size() > std::numeric_limits<uint32_t>::max() ||
+            value_bytes.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("Snapshot record too large");
+        }
+
+        const uint64_t offset = out.size();
+        const uint32_t sizes[2] = {static_cast<uint32_t>(key_bytes.size()),
+                                   static_cast<uint32_t>(value_bytes.size())};
+        out.append(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+        out.append(key_bytes);
+        out.append(value_bytes);
+
+        const uint64_t hash = hash_bytes(key_bytes);
+        uint64_t slot = hash & (slot_count - 1);
+        while (slots[slot].offset != 0) slot = (slot + 1) & (slot_count - 1);
+        slots[slot] = Slot{hash, offset, ordinal};
+    }
+
+    out.resize((out.size() + 7) & ~size_t(7));
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.count = entries.size();
+    header.slot_count = slot_count;
+    header.index_offset = out.size();
+    std::memcpy(&out[0], &header, sizeof(header));
+    out.append(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(Slot));
+
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+            throw std::runtime_error("Cannot write snapshot: " + tmp_path);
+        }
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+// Memory-mapped snapshot used as an LRUCache backing for warm starts. Opening only
+// validates the header; values are decoded when first requested (take()) or when
+// materialize() replays records into the cache, e.g. from a low-priority pool job.
+template <typename Key, typename Value>
+class LRUCacheSnapshot : public LRUCache<Key, Value>::Backing {
+public:
+    using LookupKey = typename LRUCache<Key, Value>::LookupKey;
+    using ValuePtr = typename LRUCache<Key, Value>::ValuePtr;
+
+    static std::shared_ptr<LRUCacheSnapshot> open(const std::string& path) {
+        return std::shared_ptr<LRUCacheSnapshot>(new LRUCacheSnapshot(path));
+    }
+
+    // Attach to cache so misses read through to the snapshot.
+    static std::shared_ptr<LRUCacheSnapshot> attach(LRUCache<Key, Value>& cache, const std::string& path) {
+        auto snapshot = open(path);
+        cache.set_backing(snapshot);
+        return snapshot;
+    }
+
+    ValuePtr take(const LookupKey& key) override {
+        const char* record = nullptr;
+        const uint64_t ordinal = find(key, record);
+        if (record == nullptr || !claim(ordinal)) return nullptr;
+        return std::make_shared<const Value>(SnapshotCodec<Value>::decode(value_bytes(record)));
+    }
+
+    void forget(const LookupKey& key) override {
+        const char* record = nullptr;
+        const uint64_t ordinal = find(key, record);
+        if (record != nullptr) claim(ordinal);
+    }
+
+    bool drained() const override { return remaining() == 0; }
+
+    // Replay up to max_records not yet taken records into cache, oldest first, so the
+    // most recently used entries end up at the front. Returns the number inserted.
+    size_t materialize(LRUCache<Key, Value>& cache, size_t max_records = std::numeric_limits<size_t>::max()) {
+        std::lock_guard<std::mutex> lock(cursor_mutex_);
+        size_t inserted = 0;
+        while (inserted < max_records && cursor_ordinal_ < count_) {
+            if (!in_records(cursor_offset_)) {
+                throw std::runtime_error("Corrupt LRUCache snapshot record");
+            }
+            const char* record = file_.data() + cursor_offset_;
+            const uint64_t ordinal = cursor_ordinal_++;
+            cursor_offset_ += record_size(record);
+            if (!claim(ordinal)) continue;
+            cache.put_if_absent(SnapshotCodec<Key>::decode(key_bytes(record)),
+                                std::make_shared<const Value>(SnapshotCodec<Value>::decode(value_bytes(record))));
+            ++inserted;
+        }
+        return inserted;
+    }
+
+    size_t size() const { return count_; }
+    size_t remaining() const { return remaining_.load(std::memory_order_relaxed); }
+
+private:
+    explicit LRUCacheSnapshot(const std::string& path) : file_(path) {
+        using namespace lru_snapshot;
+        if (file_.size() < sizeof(Header)) {
+            throw std::runtime_error("Snapshot too small: " + path);
+        }
+        const auto header = read_pod<Header>(file_.data());
+        if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+            throw std::runtime_error("Not a compatible LRUCache snapshot: " + path);
+        }
+        if (header.slot_count == 0 || (header.slot_count & (header.slot_count - 1)) != 0 ||
+            header.count > header.slot_count || header.index_offset > file_.size() ||
+            (file_.size() - header.index_offset) / sizeof(Slot) < header.slot_count) {
+            throw std::runtime_error("Corrupt LRUCache snapshot: " + path);
+        }
+
+        count_ = header.count;
+        slot_count_ = header.slot_count;
+        index_offset_ = header.index_offset;
+        remaining_ = count_;
+        taken_.reset(new std::atomic<uint8_t>[count_]());
+        cursor_offset_ = sizeof(Header);
+    }
+
+    static uint32_t key_size(const char* record) { return lru_snapshot::read_pod<uint32_t>(record); }
+    static uint32_t value_size(const char* record) { return lru_snapshot::read_pod<uint32_t>(record + 4); }
+    static uint64_t record_size(const char* record) { return 8ULL + key_size(record) + value_size(record); }
+    static std::string_view key_bytes(const char* record) { return {record + 8, key_size(record)}; }
+    static std::string_view value_bytes(const char* record) {
+        return {record + 8 + key_size(record), value_size(record)};
+    }
+
+    // Locates key in the index. Sets record to nullptr when absent.
+    uint64_t find(const LookupKey& key, const char*& record) const {
+        using namespace lru_snapshot;
+        std::string scratch;
+        std::string_view bytes;
+        if constexpr (std::is_same_v<LookupKey, std::string_view>) {
+            bytes = key;
+        } else {
+            SnapshotCodec<Key>::encode(key, scratch);
+            bytes = scratch;
+        }
+
+        const uint64_t hash = hash_bytes(bytes);
+        const char* index = file_.data() + index_offset_;
+        for (uint64_t probe = 0, slot = hash & (slot_count_ - 1); probe < slot_count_;
+             ++probe, slot = (slot + 1) & (slot_count_ - 1)) {
+            const auto entry = read_pod<Slot>(index + slot * sizeof(Slot));
+            if (entry.offset == 0) break;
+            if (entry.hash != hash || entry.ordinal >= count_ || !in_records(entry.offset)) continue;
+            const char* candidate = file_.data() + entry.offset;
+            if (key_bytes(candidate) == bytes) {
+                record = candidate;
+                return entry.ordinal;
+            }
+        }
+        record = nullptr;
+        return 0;
+    }
+
+    bool in_records(uint64_t offset) const {
+        return offset >= sizeof(lru_snapshot::Header) && offset + 8 <= index_offset_ &&
+               offset + record_size(file_.data() + offset) <= index_offset_;
+    }
+
+    // Each record is handed out (or superseded) at most once.
+    bool claim(uint64_t ordinal) {
+        if (taken_[ordinal].exchange(1, std::memory_order_acq_rel) != 0) return false;
+        remaining_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    MappedFile file_;
+    uint64_t count_ = 0;
+    uint64_t slot_count_ = 0;
+    uint64_t index_offset_ = 0;
+    std::unique_ptr<std::atomic<uint8_t>[]> taken_;
+    std::atomic<size_t> remaining_{0};
+
+    std::mutex cursor_mutex_;
+    uint64_t cursor_offset_ = 0;
+    uint64_t cursor_ordinal_ = 0;
+};
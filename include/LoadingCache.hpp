@@ -0,0 +1,219 @@
+#pragma once
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include "SingleFlightCache.hpp"
+#include "ThreadPool.hpp"
+
+// Read-through cache that loads missing keys on a ThreadPool and refreshes ahead.
+// Once an entry is older than refresh_after, the next read schedules a background
+// reload at refresh_priority and keeps returning the old value until the new one lands.
+// Entries older than expire_after are treated as misses. Blocking get()/get_all() must
+// not be called from a job running on the same pool.
+template <typename Key, typename Value>
+class LoadingCache {
+public:
+    using ValuePtr = std::shared_ptr<const Value>;
+    using Loader = std::function<Value(const Key&)>;
+    // Loads a batch of keys in one call (one round trip). Keys left out of the result fail.
+    using BulkLoader = std::function<std::vector<std::pair<Key, Value>>(const std::vector<Key>&)>;
+
+    struct Options {
+        size_t capacity = 100;
+        std::chrono::milliseconds refresh_after = std::chrono::milliseconds(0); // 0 = never refresh
+        std::chrono::milliseconds expire_after = std::chrono::milliseconds(0);  // 0 = never expire
+        int load_priority = 10;     // misses: a caller is waiting
+        int refresh_priority = 20;  // background reloads: lower urgency than regular jobs
+        std::string job_name = "cache_load";
+    };
+
+    LoadingCache(ThreadPool& pool, Options options, Loader loader, BulkLoader bulk_loader = {})
+        : pool_(pool),
+          options_(std::move(options)),
+          loader_(std::move(loader)),
+          bulk_loader_(std::move(bulk_loader)),
+          entries_(options_.capacity) {}
+
+    ValuePtr get(const Key& key) { return get_async(key).get(); }
+
+    std::shared_future<ValuePtr> get_async(const Key& key) {
+        const auto now = Clock::now();
+        auto claim = entries_.acquire(key, [&](const Entry& entry) { return !expired(entry, now); });
+        if (claim.leader) {
+            submit_load({key}, options_.load_priority);
+        }
+        return to_value(std::move(claim.result), key, now);
+    }
+
+    // Returns values in the order of keys. All keys that need loading go to the pool as one job.
+    std::vector<ValuePtr> get_all(const std::vector<Key>& keys) {
+        const auto now = Clock::now();
+        std::vector<std::shared_future<ValuePtr>> results;
+        std::vector<Key> to_load;
+        results.reserve(keys.size());
+
+        for (const auto& key : keys) {
+            auto claim = entries_.acquire(key, [&](const Entry& entry) { return !expired(entry, now); });
+            if (claim.leader) {
+                to_load.push_back(key);
+            }
+            results.push_back(to_value(std::move(claim.result), key, now));
+        }
+
+        if (!to_load.empty()) {
+            submit_load(std::move(to_load), options_.load_priority);
+        }
+
+        std::vector<ValuePtr> values;
+        values.reserve(results.size());
+        for (auto& result : results) {
+            values.push_back(result.get());
+        }
+        return values;
+    }
+
+    // Schedule a background reload even if the entry is still fresh.
+    void refresh(const Key& key) { schedule_refresh(key); }
+
+    size_t pending_refreshes() {
+        std::lock_guard<std::mutex> lock(refresh_mutex_);
+        return refreshing_.size();
+    }
+
+    size_t size() { return entries_.cache().size(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        Value value;
+        Clock::time_point loaded_at;
+    };
+    using EntryPtr = std::shared_ptr<const Entry>;
+
+    bool expired(const Entry& entry, Clock::time_point now) const {
+        return options_.expire_after.count() > 0 && now - entry.loaded_at >= options_.expire_after;
+    }
+
+    bool needs_refresh(const Entry& entry, Clock::time_point now) const {
+        return options_.refresh_after.count() > 0 && now - entry.loaded_at >= options_.refresh_after;
+    }
+
+    // Hit path converts in place (no wait); pending loads are adapted lazily on get().
+    std::shared_future<ValuePtr> to_value(std::shared_future<EntryPtr> result, const Key& key,
+                                          Clock::time_point now) {
+        if (result.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            std::promise<ValuePtr> promise;
+            try {
+                EntryPtr entry = result.get();
+                if (needs_refresh(*entry, now)) {
+                    schedule_refresh(key);
+                }
+                promise.set_value(ValuePtr(entry, &entry->value));
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+            return promise.get_future().share();
+        }
+
+        return std::async(std::launch::deferred, [result]() {
+            EntryPtr entry = result.get();
+            return ValuePtr(entry, &entry->value);
+        }).share();
+    }
+
+    std::vector<std::pair<Key, Value>> load(const std::vector<Key>& keys) {
+        if (bulk_loader_) {
+            return bulk_loader_(keys);
+        }
+        std::vector<std::pair<Key, Value>> loaded;
+        loaded.reserve(keys.size());
+        for (const auto& key : keys) {
+            loaded.emplace_back(key, loader_(key));
+        }
+        return loaded;
+    }
+
+    void submit_load(std::vector<Key> keys, int priority) {
+        JobMetadata metadata(0, options_.job_name);
+        metadata.priority = priority;
+
+        auto shared_keys = std::make_shared<const std::vector<Key>>(std::move(keys));
+        auto fail_all = [this, shared_keys](std::exception_ptr ex) {
+            for (const auto& key : *shared_keys) {
+                entries_.fail(key, ex);
+            }
+        };
+
+        try {
+            pool_.submit(std::move(metadata), [this, shared_keys]() {
+                auto loaded = load(*shared_keys);
+                const auto loaded_at = Clock::now();
+                for (auto& item : loaded) {
+                    entries_.complete(item.first,
+                                      std::make_shared<const Entry>(Entry{std::move(item.second), loaded_at}));
+                }
+                // Keys the bulk loader skipped would otherwise wait forever.
+                if (loaded.size() < shared_keys->size()) {
+                    auto missing = std::make_exception_ptr(std::runtime_error("Loader returned no value for key"));
+                    for (const auto& key : *shared_keys) {
+                        entries_.fail(key, missing);
+                    }
+                }
+            }, fail_all);
+        } catch (...) {
+            fail_all(std::current_exception());
+            throw;
+        }
+    }
+
+    void schedule_refresh(const Key& key) {
+        {
+            std::lock_guard<std::mutex> lock(refresh_mutex_);
+            if (!refreshing_.insert(key).second) return;
+        }
+
+        JobMetadata metadata(0, options_.job_name + "_refresh");
+        metadata.priority = options_.refresh_priority;
+        metadata.allow_retry = false;
+
+        // Never block a reader on a full pool: a refresh that is not queued fails through
+        // the handler, and the next stale read tries again.
+        pool_.try_submit(std::move(metadata), [this, key]() {
+            auto loaded = load({key});
+            const auto loaded_at = Clock::now();
+            for (auto& item : loaded) {
+                entries_.cache().put_shared(item.first,
+                                            std::make_shared<const Entry>(Entry{std::move(item.second), loaded_at}));
+            }
+            finish_refresh(key);
+        }, [this, key](std::exception_ptr) {
+            // Callers keep the old value; the next stale read schedules another attempt.
+            spdlog::warn("Background refresh failed; serving previous value");
+            finish_refresh(key);
+        });
+    }
+
+    void finish_refresh(const Key& key) {
+        std::lock_guard<std::mutex> lock(refresh_mutex_);
+        refreshing_.erase(key);
+    }
+
+    ThreadPool& pool_;
+    Options options_;
+    Loader loader_;
+    BulkLoader bulk_loader_;
+    SingleFlightCache<Key, Entry> entries_;
+    std::mutex refresh_mutex_;
+    std::unordered_set<Key> refreshing_;
+};
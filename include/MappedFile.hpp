@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file. Uses mmap on POSIX so pages are faulted in on
+// first touch; other platforms fall back to reading the file into memory.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path); // throws std::runtime_error
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<char> buffer_; // fallback storage when mmap is unavailable
+};
@@ -1,13 +1,22 @@
 #pragma once
 #include <string>
+#include <functional>
+#include <map>
 #include <memory>
-#include <spdlog/spdlog.h>
-#include <prometheus/counter.h>
-#include <prometheus/gauge.h>
-#include <prometheus/registry.h>
-#include <prometheus/histogram.h>
+#include <mutex>
+#include <vector>
+#include "ContentionStats.hpp"
+#include "JobLatencyMetrics.hpp"
+#include "ShardedMetrics.hpp"
+#include "WorkerLanes.hpp"
+#include "WorkerWatchdog.hpp"
 
+namespace prometheus {
+class Collectable;
+}
 
+// Job metrics. Hot-path updates go to per-thread sharded cells (ShardedMetrics.hpp) and
+// are only summed when MetricsServer is scraped, through the collector registered by init().
 class Metrics {
 public:
     static Metrics& instance() {
@@ -17,23 +26,104 @@ public:
 
     void init(const std::string& endpoint = "/metrics");
 
-    // Accessors for Prometheus metrics
-    prometheus::Counter& job_submitted() { return *job_submitted_; }
-    prometheus::Counter& job_completed() { return *job_completed_; }
-    prometheus::Counter& job_failed()    { return *job_failed_; }
-    prometheus::Gauge&   active_jobs()   { return *active_jobs_; }
-    prometheus::Histogram& job_latency();
+    ShardedCounter& job_submitted() { return job_submitted_; }
+    ShardedCounter& job_completed() { return job_completed_; }
+    ShardedCounter& job_failed()    { return job_failed_; }
+    ShardedCounter& job_rejected()  { return job_rejected_; } // refused by a full queue
+    ShardedCounter& job_dropped()   { return job_dropped_; }  // evicted by the overflow policy
+    ShardedCounter& job_coalesced() { return job_coalesced_; } // merged into a queued job
+    ShardedCounter& job_batches()   { return job_batches_; }   // handler calls for batched jobs
+    ShardedCounter& strand_deferred() { return strand_deferred_; } // held behind a job with the same key
+    ShardedCounter& strand_handoff()  { return strand_handoff_; }  // run by the worker that ran the key last
+    ShardedGauge&   active_jobs()   { return active_jobs_; }
+    ShardedHistogram& job_latency() { return job_latency_; }
 
+    // Per (job name, priority) latency series; see JobLatencyMetrics.hpp.
+    int job_series(const std::string& name, int priority) { return job_timing_.resolve(name, priority); }
+    ShardedLogHistogram& job_queue_wait(int series) { return job_timing_.queue_wait(series); }
+    ShardedLogHistogram& job_execution(int series)  { return job_timing_.execution(series); }
+    ShardedLogHistogram& job_end_to_end(int series) { return job_timing_.end_to_end(series); }
+    const JobLatencyMetrics& job_timing() const { return job_timing_; }
+
+    // Pools register a callback that reports their contention stats at scrape time.
+    int add_contention_source(std::function<PoolContentionStats()> source) {
+        std::lock_guard<std::mutex> lock(sources_mutex_);
+        sources_.emplace(next_source_, std::move(source));
+        return next_source_++;
+    }
+    void remove_contention_source(int id) {
+        std::lock_guard<std::mutex> lock(sources_mutex_);
+        sources_.erase(id);
+    }
+    std::vector<PoolContentionStats> contention_stats() {
+        std::lock_guard<std::mutex> lock(sources_mutex_);
+        std::vector<PoolContentionStats> out;
+        for (auto& entry : sources_) {
+            out.push_back(entry.second());
+        }
+        return out;
+    }
+
+    // Pools with a watchdog register a callback that reports stuck workers at scrape time.
+    int add_watchdog_source(std::function<WatchdogStats()> source) {
+        std::lock_guard<std::mutex> lock(sources_mutex_);
+        watchdog_sources_.emplace(next_source_, std::move(source));
+        return next_source_++;
+    }
+    void remove_watchdog_source(int id) {
+        std::lock_guard<std::mutex> lock(sources_mutex_);
+        watchdog_sources_.erase(id);
+    }
+    std::vector<WatchdogStats> watchdog_stats() {
+        std::lock_guard<std::mutex> lock(sources_mutex_);
+        std::vector<WatchdogStats> out;
+        for (auto& entry : watchdog_sources_) {
+            out.push_back(entry.second());
+        }
+        return out;
+    }
+
+    // Pools with reserved lanes register a callback that reports per-class stats at scrape time.
+    int add_lane_source(std::function<LaneStats()> source) {
+        std::lock_guard<std::mutex> lock(sources_mutex_);
+        lane_sources_.emplace(next_source_, std::move(source));
+        return next_source_++;
+    }
+    void remove_lane_source(int id) {
+        std::lock_guard<std::mutex> lock(sources_mutex_);
+        lane_sources_.erase(id);
+    }
+    std::vector<LaneStats> lane_stats() {
+        std::lock_guard<std::mutex> lock(sources_mutex_);
+        std::vector<LaneStats> out;
+        for (auto& entry : lane_sources_) {
+            out.push_back(entry.second());
+        }
+        return out;
+    }
 
 private:
-    Metrics() = default;
+    Metrics() : job_latency_({0.01, 0.05, 0.1, 0.3, 0.5, 1.0, 2.0}) {}
+
+    ShardedCounter job_submitted_;
+    ShardedCounter job_completed_;
+    ShardedCounter job_failed_;
+    ShardedCounter job_rejected_;
+    ShardedCounter job_dropped_;
+    ShardedCounter job_coalesced_;
+    ShardedCounter job_batches_;
+    ShardedCounter strand_deferred_;
+    ShardedCounter strand_handoff_;
+    ShardedGauge   active_jobs_;
+    ShardedHistogram job_latency_;
+    JobLatencyMetrics job_timing_;
 
-    std::shared_ptr<prometheus::Registry> registry_;
-    prometheus::Counter* job_submitted_ = nullptr;
-    prometheus::Counter* job_completed_ = nullptr;
-    prometheus::Counter* job_failed_ = nullptr;
-    prometheus::Gauge*   active_jobs_ = nullptr;
-    prometheus::Histogram* job_latency_;
+    std::mutex sources_mutex_;
+    std::map<int, std::function<PoolContentionStats()>> sources_;
+    std::map<int, std::function<WatchdogStats()>> watchdog_sources_;
+    std::map<int, std::function<LaneStats()>> lane_sources_;
+    int next_source_ = 0;
 
+    std::shared_ptr<prometheus::Collectable> collector_;
     std::string endpoint_;
 };
@@ -1,5 +1,7 @@
 #pragma once
 #include <memory>
+#include <string>
+#include <vector>
 #include <prometheus/exposer.h>
 #include <prometheus/registry.h>
 
@@ -8,9 +10,12 @@ public:
     static MetricsServer& instance();
     void start(const std::string& address = "127.0.0.1:8080");
     std::shared_ptr<prometheus::Registry> getRegistry();
+    // Expose an extra collectable (e.g. one that aggregates sharded metrics at scrape time).
+    void registerCollectable(const std::shared_ptr<prometheus::Collectable>& collectable);
 
 private:
     MetricsServer() = default;
     std::unique_ptr<prometheus::Exposer> exposer_;
     std::shared_ptr<prometheus::Registry> registry_;
+    std::vector<std::shared_ptr<prometheus::Collectable>> collectables_;
 };
@@ -1,4 +1,9 @@
 #pragma once
+#include <functional>
+#include <string>
+#include "ContentionStats.hpp"
+#include "WorkerLanes.hpp"
+#include "WorkerWatchdog.hpp"
 
 class DummyCounter {
 public:
@@ -15,6 +20,7 @@ public:
 class DummyHistogram {
 public:
     void Observe(double) {}
+    void ObserveNanos(long long) {}
 };
 
 class Metrics {
@@ -29,9 +35,27 @@ public:
     DummyCounter& job_submitted() { return counter_; }
     DummyCounter& job_completed() { return counter_; }
     DummyCounter& job_failed()    { return counter_; }
+    DummyCounter& job_rejected()  { return counter_; }
+    DummyCounter& job_dropped()   { return counter_; }
+    DummyCounter& job_coalesced() { return counter_; }
+    DummyCounter& job_batches()   { return counter_; }
+    DummyCounter& strand_deferred() { return counter_; }
+    DummyCounter& strand_handoff()  { return counter_; }
     DummyGauge&   active_jobs()   { return gauge_; }
     DummyHistogram& job_latency() { return histogram_; }
 
+    int job_series(const std::string&, int) { return 0; }
+    DummyHistogram& job_queue_wait(int) { return histogram_; }
+    DummyHistogram& job_execution(int)  { return histogram_; }
+    DummyHistogram& job_end_to_end(int) { return histogram_; }
+
+    int add_contention_source(std::function<PoolContentionStats()>) { return -1; }
+    void remove_contention_source(int) {}
+    int add_watchdog_source(std::function<WatchdogStats()>) { return -1; }
+    void remove_watchdog_source(int) {}
+    int add_lane_source(std::function<LaneStats()>) { return -1; }
+    void remove_lane_source(int) {}
+
 private:
     DummyCounter counter_;
     DummyGauge gauge_;
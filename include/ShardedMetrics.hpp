@@ -0,0 +1,172 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+// Per-thread sharded metric cells.
+//
+// Every thread that updates a metric gets its own slab of int64 cells, cache-line aligned
+// and written only by that thread, so updates are a plain relaxed load + store with no
+// locked instruction and no cache-line ping-pong between cores. Readers (the Prometheus
+// scrape) sum a cell across all live slabs plus the totals folded in from exited threads.
+namespace metrics_shard {
+
+constexpr size_t kCacheLine = 64;
+constexpr size_t kChunkCells = 512;  // 4 KiB per chunk, allocated on first touch
+constexpr size_t kMaxChunks = 256;   // up to 128k cells per thread
+
+struct alignas(kCacheLine) Chunk {
+    std::atomic<int64_t> cells[kChunkCells];
+    Chunk();
+};
+
+struct alignas(kCacheLine) Slab {
+    std::atomic<Chunk*> chunks[kMaxChunks];
+    Slab();
+    ~Slab();
+    Chunk* grow(size_t chunk_index);
+};
+
+class Registry {
+public:
+    static Registry& instance();
+
+    // Reserve count consecutive cells. Throws std::length_error when the slab space is exhausted.
+    size_t allocate(size_t count);
+
+    // Sum cells [first, first + count) over every thread into out (resized to count).
+    void sum(size_t first, size_t count, std::vector<int64_t>& out);
+    int64_t sum(size_t cell);
+
+    void attach(Slab* slab);
+    void detach(Slab* slab); // folds the slab into retired totals
+
+private:
+    Registry() = default;
+
+    std::atomic<size_t> next_cell_{0};
+    std::mutex mutex_;
+    std::vector<Slab*> live_;
+    Slab retired_;
+};
+
+Slab& local_slab();
+
+inline void add(size_t cell, int64_t delta) {
+    Slab& slab = local_slab();
+    Chunk* chunk = slab.chunks[cell / kChunkCells].load(std::memory_order_acquire);
+    if (chunk == nullptr) {
+        chunk = slab.grow(cell / kChunkCells);
+    }
+    // Single writer per slab: no read-modify-write instruction needed.
+    auto& slot = chunk->cells[cell % kChunkCells];
+    slot.store(slot.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+} // namespace metrics_shard
+
+class ShardedCounter {
+public:
+    ShardedCounter() : cell_(metrics_shard::Registry::instance().allocate(1)) {}
+
+    void Increment(int64_t amount = 1) { metrics_shard::add(cell_, amount); }
+    double Value() const { return static_cast<double>(metrics_shard::Registry::instance().sum(cell_)); }
+
+private:
+    size_t cell_;
+};
+
+class ShardedGauge {
+public:
+    ShardedGauge() : cell_(metrics_shard::Registry::instance().allocate(1)) {}
+
+    void Increment(int64_t amount = 1) { metrics_shard::add(cell_, amount); }
+    void Decrement(int64_t amount = 1) { metrics_shard::add(cell_, -amount); }
+    double Value() const { return static_cast<double>(metrics_shard::Registry::instance().sum(cell_)); }
+
+private:
+    size_t cell_;
+};
+
+// Fixed-bucket histogram. Cells: one per finite bucket, one for +Inf, one for the sum,
+// which is kept in fixed point (1e-9 units) so shards merge by integer addition.
+class ShardedHistogram {
+public:
+    struct Snapshot {
+        std::vector<double> upper_bounds;       // finite bounds; +Inf is implied
+        std::vector<uint64_t> cumulative_counts; // upper_bounds.size() + 1 entries
+        uint64_t count = 0;
+        double sum = 0.0;
+
+        // Upper bound of the bucket holding the q-quantile (0 when empty, +Inf past the last bound).
+        double quantile(double q) const {
+            if (count == 0) return 0.0;
+            const double rank = q * static_cast<double>(count);
+            for (size_t i = 0; i < cumulative_counts.size(); ++i) {
+                if (static_cast<double>(cumulative_counts[i]) >= rank) {
+                    return i < upper_bounds.size() ? upper_bounds[i] : std::numeric_limits<double>::infinity();
+                }
+            }
+            return std::numeric_limits<double>::infinity();
+        }
+    };
+
+    explicit ShardedHistogram(std::vector<double> upper_bounds);
+    ShardedHistogram(std::initializer_list<double> upper_bounds)
+        : ShardedHistogram(std::vector<double>(upper_bounds)) {}
+
+    void Observe(double value);
+    Snapshot snapshot() const;
+
+private:
+    std::vector<double> bounds_;
+    size_t first_cell_;
+};
+
+// HDR-style log-linear histogram over durations, from ~1us to ~73 minutes. Each power-of-two
+// range of nanoseconds is split into kSubBuckets linear buckets, so any recorded value is
+// within 1/kSubBuckets (12.5%) of its bucket's upper bound. The bucket index is computed
+// from the bit width of the value, with no search over bounds.
+class ShardedLogHistogram {
+public:
+    static constexpr int kSubBucketBits = 3;
+    static constexpr int64_t kSubBuckets = int64_t(1) << kSubBucketBits;
+    static constexpr int kMinExponent = 10; // first bucket: <= 1024 ns
+    static constexpr int kMaxExponent = 42; // values above 2^42 ns (~73 min) land in +Inf
+    static constexpr size_t kFiniteBuckets = 1 + (kMaxExponent - kMinExponent) * kSubBuckets;
+
+    ShardedLogHistogram();
+
+    void Observe(double seconds);
+    void ObserveNanos(int64_t nanos) {
+        metrics_shard::add(first_cell_ + bucket_index(nanos), 1);
+        metrics_shard::add(first_cell_ + kFiniteBuckets + 1, nanos > 0 ? nanos : 0);
+    }
+
+    ShardedHistogram::Snapshot snapshot() const;
+
+    // Finite upper bounds in seconds, shared by every instance.
+    static const std::vector<double>& upper_bounds();
+
+    // Bucket b covers (upper(b - 1), upper(b)] nanoseconds; kFiniteBuckets is +Inf.
+    static size_t bucket_index(int64_t nanos) {
+        if (nanos <= (int64_t(1) << kMinExponent)) return 0;
+        const uint64_t v = static_cast<uint64_t>(nanos) - 1;
+#if defined(__GNUC__) || defined(__clang__)
+        const int exponent = 63 - __builtin_clzll(v);
+#else
+        int exponent = 63;
+        while ((v >> exponent) == 0) --exponent;
+#endif
+        if (exponent >= kMaxExponent) return kFiniteBuckets;
+        const uint64_t sub = (v >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+        return 1 + static_cast<size_t>(exponent - kMinExponent) * kSubBuckets + static_cast<size_t>(sub);
+    }
+
+private:
+    size_t first_cell_;
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include "LRUCache.hpp"
+
+// LRUCache plus a table of in-flight computations, so concurrent misses for the
+// same key share one computation instead of each recomputing the value.
+// ThreadPool::submit_memoized() drives it; acquire/complete/fail are the protocol.
+template <typename Key, typename Value>
+class SingleFlightCache {
+public:
+    using key_type = Key;
+    using ValuePtr = typename LRUCache<Key, Value>::ValuePtr;
+    using Result = std::shared_future<ValuePtr>;
+
+    struct Claim {
+        Result result;
+        // Set only for the caller that must run the computation and report back.
+        std::shared_ptr<std::promise<ValuePtr>> leader;
+    };
+
+    explicit SingleFlightCache(size_t capacity) : cache_(capacity) {}
+
+    LRUCache<Key, Value>& cache() { return cache_; }
+
+    // Returns a ready result on hit, the pending result if another caller is computing
+    // the key, or a new pending result with leader set.
+    Claim acquire(const Key& key) {
+        return acquire(key, [](const Value&) { return true; });
+    }
+
+    // Same as acquire(key), but a cached value only counts as a hit if usable(value)
+    // returns true (e.g. it has not expired).
+    template <typename Usable>
+    Claim acquire(const Key& key, Usable&& usable) {
+        ValuePtr cached = cache_.get_shared(key);
+        if (cached && usable(*cached)) {
+            return Claim{ready(std::move(cached)), nullptr};
+        }
+
+        std::lock_guard<std::mutex> lock(inflight_mutex_);
+        // Re-check under the in-flight lock: complete() publishes to the cache while holding it.
+        cached = cache_.get_shared(key);
+        if (cached && usable(*cached)) {
+            return Claim{ready(std::move(cached)), nullptr};
+        }
+
+        auto it = inflight_.find(key);
+        if (it != inflight_.end()) {
+            return Claim{it->second.result, nullptr};
+        }
+
+        auto promise = std::make_shared<std::promise<ValuePtr>>();
+        Result result = promise->get_future().share();
+        inflight_.emplace(key, Pending{result, promise});
+        return Claim{std::move(result), std::move(promise)};
+    }
+
+    // Publish the value to the cache and wake every waiter on the key.
+    void complete(const Key& key, ValuePtr value) {
+        auto promise = release(key, [&] { cache_.put_shared(key, value); });
+        if (promise) {
+            promise->set_value(std::move(value));
+        }
+    }
+
+    // Fail every waiter on the key. Nothing is cached, so the next acquire recomputes.
+    void fail(const Key& key, std::exception_ptr ex) {
+        auto promise = release(key, [] {});
+        if (promise) {
+            promise->set_exception(std::move(ex));
+        }
+    }
+
+    size_t inflight() {
+        std::lock_guard<std::mutex> lock(inflight_mutex_);
+        return inflight_.size();
+    }
+
+private:
+    struct Pending {
+        Result result;
+        std::shared_ptr<std::promise<ValuePtr>> promise;
+    };
+
+    static Result ready(ValuePtr value) {
+        std::promise<ValuePtr> promise;
+        promise.set_value(std::move(value));
+        return promise.get_future().share();
+    }
+
+    template <typename Publish>
+    std::shared_ptr<std::promise<ValuePtr>> release(const Key& key, Publish&& publish) {
+        std::lock_guard<std::mutex> lock(inflight_mutex_);
+        auto it = inflight_.find(key);
+        if (it == inflight_.end()) return nullptr;
+        publish();
+        auto promise = std::move(it->second.promise);
+        inflight_.erase(it);
+        return promise;
+    }
+
+    LRUCache<Key, Value> cache_;
+    std::mutex inflight_mutex_;
+    std::unordered_map<Key, Pending> inflight_;
+};
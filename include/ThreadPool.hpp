@@ -1,32 +1,393 @@
 #pragma once
 
 #include <vector>
+#include <deque>
 #include <thread>
 #include <atomic>//for thread-safe flag operations.
+#include "CompletionQueue.hpp"
 #include "JobQueue.hpp"
+#include "SingleFlightCache.hpp"
 #include <sstream>
 #include <future>
+#include <memory>
 #include <stdexcept>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <spdlog/spdlog.h>
+#include "JobLog.hpp"
+#include "WorkerLanes.hpp"
+#include "WorkerWatchdog.hpp"
 #ifdef DISABLE_METRICS
 #include "MetricsStub.hpp"
 #else
 #include "Metrics.hpp"
 #endif
 
+enum class SubmitStatus {
+    Accepted, // queued, possibly after evicting another job
+    Rejected, // queue full and the overflow policy kept the job out
+    Timeout,  // queue still full when submit_for's timeout ran out
+    Shutdown,
+    Overloaded, // load shedding is refusing this priority
+    Coalesced,  // merged into a queued job with the same coalesce_key
+};
+
+// Called once per batch with the items of every job in it, in batch order. Returns one
+// result per item in the same order (nothing for Result = void).
+template <typename Item, typename Result>
+using BatchHandler = std::conditional_t<std::is_void_v<Result>, std::function<void(std::vector<Item>&)>,
+                                        std::function<std::vector<Result>(std::vector<Item>&)>>;
+
+template <typename T>
+struct Submitted {
+    SubmitStatus status;
+    std::future<T> future; // always valid; holds the exception if the job was not accepted
+
+    bool accepted() const { return status == SubmitStatus::Accepted || status == SubmitStatus::Coalesced; }
+};
 
+// Keyed strands: jobs submitted with the same nonzero JobMetadata::strand_key run one at a
+// time, in submit order, while different keys run in parallel. Only the oldest job of a
+// key sits in the queue; the rest wait in the pool's strand table without a worker, each
+// holding a reserved queue slot so max_queue_size and the overflow policy still apply.
+// When a job ends (for good, not to retry), the worker that ran it runs the key's next
+// job itself, skipping the queue and keeping the key's data in its caches, for up to
+// kStrandBurst jobs in a row before it sends the next one through the queue.
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t num_threads, size_t max_queue_size = 100);
+    static constexpr uint32_t kStrandBurst = 16;
+
+    explicit ThreadPool(size_t num_threads, size_t max_queue_size = 100, WatchdogOptions watchdog = {},
+                        LaneOptions lanes = {});
     ~ThreadPool();//called automatically when the ThreadPool object goes out of scope or is deleted.
     void submit(JobMetadata&& metadata, std::function<void()> task);
+    // Fire-and-forget submit whose on_failure runs on terminal failure (retries exhausted,
+    // expiry, cancellation or shutdown), so callers can release waiters without a future.
+    void submit(JobMetadata&& metadata, std::function<void()> task,
+                std::function<void(std::exception_ptr)> on_failure);
     template<typename Func>
     auto submit(JobMetadata&& metadata, Func&& func) -> std::future<decltype(func())> {
         if (!running_) {
             throw std::runtime_error("Cannot submit job: ThreadPool is shut down");
         }
+        auto pending = make_future_job(std::move(metadata), std::forward<Func>(func));
+        //DIRECTLY enqueue the job instead of calling another submit()
+        enqueue(std::move(pending.first));
+
+        return std::move(pending.second);
+    }
+
+    // Non-blocking and timed submits: instead of waiting on a full queue they return a
+    // status. try_submit never waits; submit_for waits up to timeout for room. Either one
+    // then applies the overflow policy. A job that is not accepted has its future (or
+    // on_failure) completed with an exception as well.
+    SubmitStatus try_submit(JobMetadata&& metadata, std::function<void()> task,
+                            std::function<void(std::exception_ptr)> on_failure);
+    SubmitStatus submit_for(JobMetadata&& metadata, std::chrono::milliseconds timeout, std::function<void()> task,
+                            std::function<void(std::exception_ptr)> on_failure);
+    template<typename Func>
+    auto try_submit(JobMetadata&& metadata, Func&& func) -> Submitted<decltype(func())> {
+        auto [job, future] = make_future_job(std::move(metadata), std::forward<Func>(func));
+        const auto status = admit(job, std::chrono::steady_clock::now());
+        return {status, std::move(future)};
+    }
+    template<typename Func>
+    auto submit_for(JobMetadata&& metadata, std::chrono::milliseconds timeout, Func&& func)
+        -> Submitted<decltype(func())> {
+        auto [job, future] = make_future_job(std::move(metadata), std::forward<Func>(func));
+        const auto status = admit(job, std::chrono::steady_clock::now() + timeout);
+        return {status, std::move(future)};
+    }
+
+    // What a full queue does with a new job. Block (the default) keeps submit() blocking;
+    // under any other policy submit() never waits and throws if the job is not admitted.
+    // Evicted jobs fail with an exception and count in jobs_dropped_total.
+    void set_overflow_policy(JobQueue::OverflowPolicy policy) { overflow_policy_.store(policy); }
+    JobQueue::OverflowPolicy overflow_policy() const { return overflow_policy_.load(); }
+
+    // CoDel-style load shedding on queue wait (see JobQueue::SheddingOptions). Shed jobs
+    // fail with an exception and count in jobs_dropped_total; refused submits count in
+    // jobs_rejected_total (submit() throws, try_submit/submit_for return Overloaded).
+    // Jobs above shed_priority are never shed, so they keep a short queue.
+    void set_load_shedding(JobQueue::SheddingOptions options) { job_queue_.set_shedding(options); }
+    bool shedding() { return job_queue_.shedding(); }
+
+    // Escalation without cancel and resubmit: moves the queued job with this
+    // JobMetadata::handle, or every queued job of a JobMetadata::group, to new_priority in
+    // place (see JobQueue::reprioritize). Jobs already running or held in a strand are not
+    // affected. Latency metrics keep the series of the priority the job was submitted with.
+    bool reprioritize(uint64_t handle, int new_priority) { return job_queue_.reprioritize(handle, new_priority); }
+    size_t reprioritize_group(uint64_t group, int new_priority) {
+        return job_queue_.reprioritize_group(group, new_priority);
+    }
+
+    // Coalescing submit: while a job with the same JobMetadata::coalesce_key is still
+    // queued, this one merges into it instead of taking a slot (see JobQueue::PushStatus).
+    // The queued job runs once and every caller's future gets its result or exception.
+    // Futures are shared for that reason. Use only this or fire-and-forget submit() for a
+    // key: the future-returning submits reject a coalesce_key, since their futures could
+    // not be completed from another job.
+    template<typename Func>
+    auto submit_coalesced(JobMetadata&& metadata, Func&& func) -> std::shared_future<decltype(func())> {
+        using ResultType = decltype(func());
+        if (!running_) {
+            throw std::runtime_error("Cannot submit job: ThreadPool is shut down");
+        }
+        require_no_batching(metadata);
+
+        auto promise = std::make_shared<std::promise<ResultType>>();
+        auto state = std::make_shared<CoalescedResult<ResultType>>();
+        state->result = promise->get_future().share();
+        std::function<void()> wrapper = [promise, f = std::forward<Func>(func)]() mutable {
+            if constexpr (std::is_void_v<ResultType>) {
+                f();
+                promise->set_value();
+            } else {
+                promise->set_value(f());
+            }
+        };
+        auto failure_handler = [promise](std::exception_ptr ex) {
+            promise->set_exception(std::move(ex));
+        };
+
+        JobQueue::Job job(std::move(metadata), std::move(wrapper), std::move(failure_handler));
+        job.shared_state = state;
+        if (enqueue(std::move(job)) == SubmitStatus::Coalesced) {
+            auto queued = std::dynamic_pointer_cast<CoalescedResult<ResultType>>(job.shared_state);
+            if (!queued) {
+                throw std::runtime_error("Cannot coalesce job: the queued job for this key has another result type");
+            }
+            return queued->result;
+        }
+        return state->result;
+    }
+
+    // Micro-batching: register_batch() sets the handler and limits for a batch key, then
+    // submit_batched() queues one item per job with metadata.batch_key set. A worker that
+    // pops such a job takes up to options.max_size queued jobs of the key at once, lingers
+    // up to options.linger for more, and calls handler once. Each item's future gets its own
+    // result. If the handler throws, every item in the batch fails. Batched jobs are not
+    // retried. Expired or cancelled items are left out of the batch. Item and Result must
+    // match the registration exactly, e.g. pool.submit_batched<bool>(meta, std::string(row)).
+    template <typename Item, typename Result>
+    void register_batch(uint64_t batch_key, JobQueue::BatchOptions options, BatchHandler<Item, Result> handler) {
+        if (batch_key == 0) {
+            throw std::runtime_error("Cannot register batch handler: batch key must be nonzero");
+        }
+        auto runner = std::make_shared<TypedBatchRunner<Item, Result>>();
+        runner->handler = std::move(handler);
+        {
+            std::lock_guard<std::mutex> lock(batch_mutex_);
+            if (!batch_runners_.emplace(batch_key, std::move(runner)).second) {
+                throw std::runtime_error("Cannot register batch handler: batch key already registered");
+            }
+        }
+        job_queue_.set_batching(batch_key, options);
+    }
+
+    template <typename Result, typename Item>
+    std::future<Result> submit_batched(JobMetadata&& metadata, Item item) {
+        if (!running_) {
+            throw std::runtime_error("Cannot submit job: ThreadPool is shut down");
+        }
+        require_no_coalescing(metadata);
+        {
+            std::lock_guard<std::mutex> lock(batch_mutex_);
+            auto runner = batch_runners_.find(metadata.batch_key);
+            if (runner == batch_runners_.end()) {
+                throw std::runtime_error("Cannot submit job: no batch handler registered for its batch_key");
+            }
+            if (dynamic_cast<TypedBatchRunner<Item, Result>*>(runner->second.get()) == nullptr) {
+                throw std::runtime_error("Cannot submit job: item or result type differs from the batch handler");
+            }
+        }
+
+        auto state = std::make_shared<BatchItem<Item, Result>>();
+        state->item = std::move(item);
+        auto future = state->promise.get_future();
+        JobQueue::Job job(std::move(metadata), {}, [state](std::exception_ptr ex) {
+            state->promise.set_exception(std::move(ex));
+        });
+        job.shared_state = std::move(state);
+        enqueue(std::move(job));
+        return future;
+    }
+
+    // Tagged submit: the result, or the terminal exception, is pushed to completions
+    // with tag instead of completing a future. completions must outlive the job.
+    template<typename Func>
+    void submit_tagged(JobMetadata&& metadata, CompletionQueue<std::invoke_result_t<Func&>>& completions,
+                       uint64_t tag, Func&& func) {
+        if (!running_) {
+            throw std::runtime_error("Cannot submit job: ThreadPool is shut down");
+        }
+        require_no_coalescing(metadata);
+        require_no_batching(metadata);
+
+        auto failure_handler = [&completions, tag](std::exception_ptr ex) {
+            completions.push_error(tag, std::move(ex));
+        };
+
+        std::function<void()> wrapper = [&completions, tag, f = std::forward<Func>(func)]() mutable {
+            completions.push(tag, f());
+        };
+
+        enqueue(JobQueue::Job(std::move(metadata), std::move(wrapper), std::move(failure_handler)));
+    }
+
+    // Single-flight submit: returns the cached value if present, joins the pending
+    // computation if another caller already submitted this key, otherwise submits one
+    // job whose result is cached and fanned out to every waiter. Failures reach all
+    // waiters and are not cached.
+    template<typename Key, typename Value, typename Func>
+    std::shared_future<std::shared_ptr<const Value>> submit_memoized(SingleFlightCache<Key, Value>& cache,
+                                                                     JobMetadata&& metadata,
+                                                                     const typename SingleFlightCache<Key, Value>::key_type& key,
+                                                                     Func&& func) {
+        if (!running_) {
+            throw std::runtime_error("Cannot submit job: ThreadPool is shut down");
+        }
+        require_no_coalescing(metadata);
+        require_no_batching(metadata);
+
+        auto claim = cache.acquire(key);
+        if (!claim.leader) {
+            return claim.result;
+        }
+
+        auto failure_handler = [&cache, key](std::exception_ptr ex) {
+            cache.fail(key, std::move(ex));
+        };
+
+        std::function<void()> wrapper = [&cache, key, f = std::forward<Func>(func)]() mutable {
+            cache.complete(key, std::make_shared<const Value>(f()));
+        };
+
+        try {
+            enqueue(JobQueue::Job(std::move(metadata), std::move(wrapper), std::move(failure_handler)));
+        } catch (...) {
+            cache.fail(key, std::current_exception());
+            throw;
+        }
+
+        return claim.result;
+    }
+
+
+    void shutdown(int timeout_seconds = 5);
+
+    // Queue lock/condition-variable contention and per-worker busy/idle time.
+    // All zero unless built with JOBQUEUE_CONTENTION_STATS.
+    PoolContentionStats contention_stats();
+
+    // Stuck and long-running jobs right now. All zero unless the watchdog or blocking
+    // workers are enabled.
+    WatchdogStats watchdog_stats() const;
+
+    // Managed blocking: a job opens a section around a call that blocks (I/O, a lock) and
+    // the pool starts a compensating worker for it, up to max_blocking_workers, so CPU
+    // jobs keep running. The extra worker retires at its next job boundary after the
+    // section closes. Use only on pool threads, e.g.
+    //   { ThreadPool::BlockingSection blocking(pool); read(fd, buf, n); }
+    class BlockingSection {
+    public:
+        explicit BlockingSection(ThreadPool& pool);
+        ~BlockingSection();
+        BlockingSection(const BlockingSection&) = delete;
+        BlockingSection& operator=(const BlockingSection&) = delete;
+
+    private:
+        ThreadPool& pool_;
+    };
+
+    // Per-class utilization and queue wait. All zero unless reserved lanes are configured.
+    LaneStats lane_stats() const;
+
+private:
+    struct alignas(64) WorkerSlot {
+        std::atomic<uint64_t> busy_ns{0};
+        std::atomic<uint64_t> idle_ns{0};
+        std::atomic<uint64_t> jobs{0};
+        std::atomic<uint64_t> job_started_ns{0}; // 0 while not inside job.task()
+        std::atomic<int> job_id{-1};
+        std::atomic<bool> live{false};
+
+        // Lane accounting, written only while lanes are enabled. lane_wait[0] is for jobs at
+        // or below the lane's max_priority, [1] for the rest, by the worker that started them.
+        struct Wait {
+            std::atomic<uint64_t> count{0};
+            std::atomic<uint64_t> total_ns{0};
+            std::atomic<uint64_t> max_ns{0};
+        };
+        std::atomic<uint64_t> lane_run_ns{0};
+        std::atomic<uint64_t> lane_jobs{0};
+        std::atomic<uint64_t> lane_borrowed{0};
+        Wait lane_wait[2];
+    };
+
+    template <typename T>
+    struct CoalescedResult : JobQueue::SharedState {
+        std::shared_future<T> result;
+    };
+
+    template <typename Item, typename Result>
+    struct BatchItem : JobQueue::SharedState {
+        Item item;
+        std::promise<Result> promise;
+    };
+
+    struct BatchRunner {
+        virtual ~BatchRunner() = default;
+        virtual void run(std::vector<JobQueue::Job>& jobs) = 0; // throws to fail the whole batch
+    };
+
+    template <typename Item, typename Result>
+    struct TypedBatchRunner : BatchRunner {
+        BatchHandler<Item, Result> handler;
+
+        void run(std::vector<JobQueue::Job>& jobs) override {
+            std::vector<Item> items;
+            items.reserve(jobs.size());
+            for (auto& job : jobs) {
+                items.push_back(std::move(static_cast<BatchItem<Item, Result>&>(*job.shared_state).item));
+            }
+            if constexpr (std::is_void_v<Result>) {
+                handler(items);
+                for (auto& job : jobs) {
+                    static_cast<BatchItem<Item, Result>&>(*job.shared_state).promise.set_value();
+                }
+            } else {
+                std::vector<Result> results = handler(items);
+                if (results.size() != jobs.size()) {
+                    throw std::runtime_error("Batch handler returned a different number of results than items");
+                }
+                for (size_t i = 0; i < jobs.size(); ++i) {
+                    static_cast<BatchItem<Item, Result>&>(*jobs[i].shared_state).promise.set_value(std::move(results[i]));
+                }
+            }
+        }
+    };
+
+    static void require_no_coalescing(const JobMetadata& metadata) {
+        if (metadata.coalesce_key != 0) {
+            throw std::runtime_error("Cannot submit job: use submit_coalesced for a coalesce_key");
+        }
+    }
+
+    // Only submit_batched() registers a job with the batch runner its batch_key names.
+    static void require_no_batching(const JobMetadata& metadata) {
+        if (metadata.batch_key != 0) {
+            throw std::runtime_error("Cannot submit job: use submit_batched for a batch_key");
+        }
+    }
+
+    template<typename Func>
+    static auto make_future_job(JobMetadata&& metadata, Func&& func)
+        -> std::pair<JobQueue::Job, std::future<decltype(func())>> {
         using ResultType = decltype(func());
+        require_no_coalescing(metadata);
+        require_no_batching(metadata);
 
         auto promise = std::make_shared<std::promise<ResultType>>();
         auto future = promise->get_future();
@@ -46,40 +407,76 @@ public:
                     promise->set_value(result);//sets the result.
                 }
             } catch (const std::future_error& e) {
-                spdlog::warn("Promise already fulfilled or invalid: {}", e.what());
+                JOB_LOG_WARN("Promise already fulfilled or invalid: {}", e.what());
             } catch (...) {
                 throw;
             }
         };
 
-        //DIRECTLY enqueue the job instead of calling another submit()
-        jobs_in_progress_++;
-        if (!job_queue_.push(JobQueue::Job(std::move(metadata), std::move(wrapper), std::move(failure_handler)))) {
-            jobs_in_progress_--;
-            throw std::runtime_error("Cannot submit job: queue rejected enqueue during shutdown");
-        }
-        Metrics::instance().job_submitted().Increment();
-        Metrics::instance().active_jobs().Increment();
-
-        return future;
+        return {JobQueue::Job(std::move(metadata), std::move(wrapper), std::move(failure_handler)),
+                std::move(future)};
     }
 
-
-    void shutdown(int timeout_seconds = 5);
-
-private:
-    void worker_loop(); // Worker thread function
+    // Blocks or throws, per overflow policy. On Coalesced, job keeps its shared_state.
+    SubmitStatus enqueue(JobQueue::Job&& job);
+    SubmitStatus try_enqueue(JobQueue::Job& job, std::chrono::steady_clock::time_point deadline);
+    SubmitStatus admit(JobQueue::Job& job, std::chrono::steady_clock::time_point deadline);
+    void drop_evicted(JobQueue::Job& job, const char* reason);
+    void worker_loop(size_t index); // Worker thread function
+    void watchdog_loop();
+    size_t compensating_target() const;
+    void add_compensating_workers();
+    bool retire_compensating_worker();
     void complete_terminal_failure(JobQueue::Job& job, std::exception_ptr ex);
-    void notify_job_finished();
+    void run_batch(JobQueue::Job head, WorkerSlot& slot, bool reserved);
+    void note_lane_wait(WorkerSlot& slot, int priority, int64_t wait_ns);
+    void note_lane_run(WorkerSlot& slot, bool reserved, int64_t run_ns, uint64_t jobs, uint64_t borrowed);
+    enum class StrandEntry { Opened, NeedsSlot, Held };
+    StrandEntry enter_strand(JobQueue::Job& job, bool slot_reserved);
+    void strand_done(uint64_t key);
+    void notify_job_finished(const JobMetadata& metadata); // releases the job's strand
     bool wait_for_retry_delay_or_shutdown(std::chrono::milliseconds delay);
 
     std::vector<std::thread> workers_;
     JobQueue job_queue_;
     std::atomic<bool> running_;
     std::atomic<int> jobs_in_progress_{0};
+    std::atomic<JobQueue::OverflowPolicy> overflow_policy_{JobQueue::OverflowPolicy::Block};
     std::condition_variable cv_done_;
     std::mutex done_mutex_;
     std::condition_variable shutdown_cv_;
     std::mutex shutdown_mutex_;
+    std::unique_ptr<WorkerSlot[]> worker_stats_; // one per worker, written only by that worker
+    int contention_source_ = -1;
+
+    LaneOptions lane_options_;
+    bool lanes_enabled_ = false;
+    uint64_t lanes_since_ns_ = 0;
+    int lane_source_ = -1;
+
+    // Watchdog. Slots [num_threads, slot_count_) belong to compensating workers, started
+    // by the watchdog or a BlockingSection under compensating_mutex_ while running.
+    WatchdogOptions watchdog_options_;
+    bool watchdog_enabled_ = false;
+    size_t base_workers_ = 0;
+    size_t slot_count_ = 0;
+    std::thread watchdog_;
+    std::vector<std::thread> compensating_threads_;
+    std::atomic<size_t> compensating_{0};
+    std::atomic<size_t> stuck_target_{0}; // set by the watchdog
+    std::atomic<size_t> blocked_{0};      // open blocking sections
+    std::mutex compensating_mutex_;
+    std::atomic<uint64_t> stuck_jobs_total_{0};
+    int watchdog_source_ = -1;
+
+    // Strands with a job queued or running; an entry goes away when its last job ends.
+    struct Strand {
+        std::deque<JobQueue::Job> pending;
+        uint32_t burst = 0; // consecutive jobs handed to the previous job's worker
+    };
+    std::mutex strands_mutex_;
+    std::unordered_map<uint64_t, Strand> strands_;
 
+    std::mutex batch_mutex_;
+    std::unordered_map<uint64_t, std::shared_ptr<BatchRunner>> batch_runners_; // never removed
 };
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Worker reservations per priority class for ThreadPool.
+//
+// The first reserved_workers workers form a lane that only takes jobs with priority
+// <= max_priority, so a flood of long low-priority jobs cannot occupy every worker. The
+// lane is work-conserving: a lane worker borrows other work while at least
+// min_idle_reserved other lane workers are idle, which keeps that many free for the next
+// high-priority job. Shared workers take any job, high-priority ones first as before.
+struct LaneOptions {
+    size_t reserved_workers = 0; // 0 disables lanes; must be below num_threads
+    int max_priority = 0;
+    size_t min_idle_reserved = 1;
+};
+
+// One side of the split: the lane workers and the jobs at or below max_priority, or the
+// shared workers and every other job. Utilization is by worker, wait time by job.
+struct LaneClassStats {
+    size_t workers = 0;
+    double utilization = 0; // share of these workers' time spent running jobs since the pool started
+    uint64_t jobs = 0;      // jobs (attempts) these workers ran
+    uint64_t borrowed = 0;  // lane workers only: jobs above max_priority they ran
+    uint64_t waits = 0;     // first attempts of jobs in this class
+    double mean_wait_seconds = 0;
+    double max_wait_seconds = 0;
+};
+
+struct LaneStats {
+    LaneClassStats reserved;
+    LaneClassStats shared;
+};
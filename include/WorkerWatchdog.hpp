@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Stuck-job detection for ThreadPool workers.
+//
+// Each worker publishes the id and start time of the job it is running in its own
+// cache-line slot (two relaxed/release stores per job). A watchdog thread scans the
+// slots every check_interval and flags jobs running longer than stuck_threshold. With
+// max_compensating_workers > 0 it also starts extra workers, one per stuck worker up to
+// that limit, which retire before taking a new job once the stuck count drops again.
+//
+// Jobs can also declare that they block (ThreadPool::BlockingSection or
+// JobMetadata::blocking). Each open section gets a compensating worker right away, up to
+// max_blocking_workers, whether or not the watchdog is enabled.
+struct WatchdogOptions {
+    std::chrono::milliseconds stuck_threshold{0}; // 0 disables the watchdog
+    std::chrono::milliseconds check_interval{100};
+    size_t max_compensating_workers = 0;
+    size_t max_blocking_workers = 0;
+};
+
+struct WatchdogStats {
+    size_t stuck_workers = 0;           // workers inside one job for at least stuck_threshold
+    double longest_running_seconds = 0; // age of the oldest job currently running
+    int longest_running_job_id = -1;
+    size_t compensating_workers = 0;    // extra workers currently running
+    size_t blocked_workers = 0;         // workers inside a declared blocking section
+    uint64_t stuck_jobs_total = 0;      // jobs flagged since the pool started
+};
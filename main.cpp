@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include "ThreadPool.hpp"
 #include <mutex>
@@ -6,8 +7,15 @@
 #include <cxxopts.hpp>
 #include "Metrics.hpp"
 #include "LRUCache.hpp"
+#include "SingleFlightCache.hpp"
+#include "LRUCacheSnapshot.hpp"
+#include "AsyncLogSink.hpp"
+#include "JobProfiler.hpp"
+#include "JobRecorder.hpp"
+#include "JobTracer.hpp"
+#include <filesystem>
 
-LRUCache<std::string, int> result_cache(100); // adjust capacity as needed
+SingleFlightCache<std::string, int> result_cache(100); // adjust capacity as needed
 
 int main(int argc, char* argv[]) {
     spdlog::info("Initializing Prometheus metrics server...");
@@ -24,6 +32,17 @@ int main(int argc, char* argv[]) {
         ("timeout", "Graceful shutdown wait budget in seconds", cxxopts::value<int>()->default_value("5"))
         ("job_timeout", "Per-job timeout in milliseconds", cxxopts::value<int>()->default_value("0"))
         ("keep_alive_s", "Keep process alive after shutdown so metrics can be scraped", cxxopts::value<int>()->default_value("0"))
+        ("cache_snapshot", "Result cache snapshot file: warm start on startup, saved on shutdown", cxxopts::value<std::string>()->default_value(""))
+        ("trace", "Write a Chrome/Perfetto job lifecycle trace to this file on shutdown", cxxopts::value<std::string>()->default_value(""))
+        ("record", "Record submitted jobs to this file for bench --replay", cxxopts::value<std::string>()->default_value(""))
+        ("profile", "Record per-job CPU time and context switches; print the cost profile on shutdown")
+        ("watchdog_ms", "Flag jobs running longer than this many milliseconds as stuck (0 = off)", cxxopts::value<int>()->default_value("0"))
+        ("compensate", "Start up to this many extra workers while workers are stuck", cxxopts::value<int>()->default_value("0"))
+        ("blocking_spares", "Start up to this many extra workers while jobs are in a blocking section", cxxopts::value<int>()->default_value("0"))
+        ("reserve_workers", "Workers reserved for jobs at or below --reserve_priority", cxxopts::value<int>()->default_value("0"))
+        ("reserve_priority", "Highest priority number the reserved workers take", cxxopts::value<int>()->default_value("0"))
+        ("shed_target_us", "Shed priority >= 5 jobs once their queue wait stays above this many microseconds (0 = off)", cxxopts::value<int>()->default_value("0"))
+        ("async_log", "Log through a lock-free ring and a background flusher; drop when full instead of blocking")
         ("h,help", "Print usage");
 
     auto options_result = options.parse(argc, argv);
@@ -33,6 +52,11 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
+    std::shared_ptr<AsyncLogSink> async_log;
+    if (options_result["async_log"].as<bool>()) {
+        async_log = install_async_default_logger();
+    }
+
     int num_threads = options_result["threads"].as<int>();
     if (num_threads <= 0) {
         spdlog::error("Thread count must be positive.");
@@ -40,8 +64,46 @@ int main(int argc, char* argv[]) {
     }
     spdlog::info("Using {} worker threads", num_threads);
 
+    const std::string trace_path = options_result["trace"].as<std::string>();
+    if (!trace_path.empty()) {
+        JobTracer::instance().enable(trace_path);
+        spdlog::info("Tracing job lifecycle to {}", trace_path);
+    }
+
+    const std::string record_path = options_result["record"].as<std::string>();
+    if (!record_path.empty()) {
+        try {
+            JobRecorder::instance().start(record_path);
+            spdlog::info("Recording submitted jobs to {}", record_path);
+        } catch (const std::exception& e) {
+            spdlog::error("{}", e.what());
+            return 1;
+        }
+    }
+
+    const bool profile = options_result["profile"].as<bool>();
+    if (profile) {
+        JobProfiler::instance().enable(true);
+    }
+
     int max_queue = options_result["max_queue"].as<int>();
-    ThreadPool pool(num_threads, max_queue);
+    WatchdogOptions watchdog;
+    watchdog.stuck_threshold = std::chrono::milliseconds(std::max(0, options_result["watchdog_ms"].as<int>()));
+    watchdog.max_compensating_workers = static_cast<size_t>(std::max(0, options_result["compensate"].as<int>()));
+    watchdog.max_blocking_workers = static_cast<size_t>(std::max(0, options_result["blocking_spares"].as<int>()));
+    LaneOptions lanes;
+    lanes.reserved_workers = static_cast<size_t>(std::max(0, options_result["reserve_workers"].as<int>()));
+    lanes.max_priority = options_result["reserve_priority"].as<int>();
+    if (lanes.reserved_workers >= static_cast<size_t>(num_threads)) {
+        spdlog::error("--reserve_workers must be below the thread count.");
+        return 1;
+    }
+    ThreadPool pool(num_threads, max_queue, watchdog, lanes);
+    if (options_result["shed_target_us"].as<int>() > 0) {
+        JobQueue::SheddingOptions shedding;
+        shedding.target = std::chrono::microseconds(options_result["shed_target_us"].as<int>());
+        pool.set_load_shedding(shedding);
+    }
 
     // --- Test LRU Cache ---
     spdlog::info("Testing LRUCache with capacity 3");
@@ -79,6 +141,24 @@ int main(int argc, char* argv[]) {
 
     int job_timeout_ms = options_result["job_timeout"].as<int>();
     int keep_alive_s = options_result["keep_alive_s"].as<int>();
+    std::string cache_snapshot = options_result["cache_snapshot"].as<std::string>();
+
+    // --- Warm start: misses read through to the mmapped snapshot, the rest is replayed in the background ---
+    if (!cache_snapshot.empty() && std::filesystem::exists(cache_snapshot)) {
+        try {
+            auto warm_start = LRUCacheSnapshot<std::string, int>::attach(result_cache.cache(), cache_snapshot);
+            spdlog::info("Warm start from {} ({} cached results)", cache_snapshot, warm_start->size());
+
+            JobMetadata warm_meta(0, "cache_warm_start");
+            warm_meta.priority = 20;
+            warm_meta.allow_retry = false;
+            pool.submit(std::move(warm_meta), [warm_start]() {
+                warm_start->materialize(result_cache.cache());
+            });
+        } catch (const std::exception& ex) {
+            spdlog::warn("Ignoring cache snapshot {}: {}", cache_snapshot, ex.what());
+        }
+    }
 
     
     if (test_retry) {
@@ -124,29 +204,25 @@ int main(int argc, char* argv[]) {
     metadata.timeout = std::chrono::milliseconds(1000);  // 1 second
 
     std::string cache_key = metadata.name + std::to_string(metadata.id); // Unique cache key
-    int cached_value;
-    if (result_cache.get(cache_key, cached_value)) {
-        spdlog::info("Cache hit for job: {}", metadata.name);
-        spdlog::info("Cached result: {}", cached_value);
-    } else {
-        spdlog::info("Cache miss for job: {}", metadata.name);
-
-        std::string name_copy = metadata.name;
-        int id_copy = metadata.id;
-
-        auto future = pool.submit(std::move(metadata), [name = std::move(name_copy), id = id_copy, cache_key]() {//Caller submits job
-            spdlog::info("Executing job: {} (ID: {})", name, id);
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
-            int result = 42;
-
-            result_cache.put(cache_key, result);  // Store result in cache
-            return result;
-        });
+    std::string name_copy = metadata.name;
+    int id_copy = metadata.id;
+
+    // Cache hit, join of an in-flight computation, or a single new job for the key.
+    auto future = pool.submit_memoized(result_cache, std::move(metadata), cache_key,
+                                       [name = std::move(name_copy), id = id_copy]() {//Caller submits job
+        spdlog::info("Executing job: {} (ID: {})", name, id);
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        return 42;
+    });
 
+    if (future.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
+        spdlog::info("Cache hit for job: {}", cache_key);
+    } else {
+        spdlog::info("Cache miss for job: {}", cache_key);
         spdlog::info("Waiting for result...");
-        int result_value = future.get();//If result not ready->future blocks; When promise sets value-> future unblocks and returns result
-        spdlog::info("Result received: {}", result_value);
     }
+    int result_value = *future.get();//If result not ready->future blocks; When the job completes every waiter unblocks
+    spdlog::info("Result received: {}", result_value);
 
 
 
@@ -173,11 +249,34 @@ int main(int argc, char* argv[]) {
 
     pool.shutdown(timeout);
 
+    if (!record_path.empty()) {
+        JobRecorder::instance().stop();
+        spdlog::info("Recorded {} jobs to {}", JobRecorder::instance().recorded(), record_path);
+    }
+
+    if (profile) {
+        std::cout << "Job cost profile:\n";
+        JobProfiler::instance().dump_profile(std::cout);
+    }
+
+    if (!cache_snapshot.empty()) {
+        try {
+            save_snapshot(result_cache.cache(), cache_snapshot);
+            spdlog::info("Saved {} cached results to {}", result_cache.cache().size(), cache_snapshot);
+        } catch (const std::exception& ex) {
+            spdlog::warn("Failed to save cache snapshot {}: {}", cache_snapshot, ex.what());
+        }
+    }
+
     if (keep_alive_s > 0) {
         spdlog::info("Keeping process alive for {} seconds so metrics remain available at http://0.0.0.0:8080/metrics",
                      keep_alive_s);
         std::this_thread::sleep_for(std::chrono::seconds(keep_alive_s));
     }
 
+    if (async_log) {
+        async_log->stop();
+    }
+
     return 0;
 }
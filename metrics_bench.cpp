@@ -0,0 +1,184 @@
+// metrics_bench.cpp
+// Per-job metric update cost under contention.
+//
+// Every thread replays the updates ThreadPool makes for one job (submitted++, active++,
+// completed++, active--, latency observe) against three backends:
+// - disabled: MetricsStub no-ops (DISABLE_METRICS builds)
+// - shared:   one shared instance per metric, as with direct prometheus-cpp updates.
+//             Uses prometheus-cpp itself when available, otherwise an equivalent model
+//             (atomic<double> CAS counters, mutex-guarded histogram).
+// - sharded:  ShardedMetrics per-thread cells, summed only when read
+// For the same comparison through the real pool, run bench (DISABLE_METRICS) and
+// bench_metrics (sharded Metrics) with identical arguments.
+
+#include "MetricsStub.hpp"
+#include "ShardedMetrics.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef METRICS_BENCH_HAVE_PROMETHEUS
+#include <prometheus/counter.h>
+#include <prometheus/gauge.h>
+#include <prometheus/histogram.h>
+#include <prometheus/registry.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+const std::vector<double> kLatencyBounds = {0.01, 0.05, 0.1, 0.3, 0.5, 1.0, 2.0};
+
+struct DisabledBackend {
+    DummyCounter submitted, completed;
+    DummyGauge active;
+    DummyHistogram latency;
+};
+
+#ifdef METRICS_BENCH_HAVE_PROMETHEUS
+struct SharedBackend {
+    prometheus::Registry registry;
+    prometheus::Counter& submitted = prometheus::BuildCounter().Name("s").Register(registry).Add({});
+    prometheus::Counter& completed = prometheus::BuildCounter().Name("c").Register(registry).Add({});
+    prometheus::Gauge& active = prometheus::BuildGauge().Name("a").Register(registry).Add({});
+    prometheus::Histogram& latency = prometheus::BuildHistogram().Name("l").Register(registry).Add({}, kLatencyBounds);
+};
+#else
+class SharedValue {
+public:
+    void Increment(double v = 1.0) { change(v); }
+    void Decrement(double v = 1.0) { change(-v); }
+
+private:
+    void change(double v) {
+        double current = value_.load();
+        while (!value_.compare_exchange_weak(current, current + v)) {
+        }
+    }
+    std::atomic<double> value_{0.0};
+};
+
+class SharedHistogram {
+public:
+    void Observe(double v) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t bucket = 0;
+        while (bucket < kLatencyBounds.size() && v > kLatencyBounds[bucket]) ++bucket;
+        buckets_[bucket].Increment();
+        sum_.Increment(v);
+    }
+
+private:
+    std::mutex mutex_;
+    SharedValue buckets_[8];
+    SharedValue sum_;
+};
+
+struct SharedBackend {
+    SharedValue submitted, completed, active;
+    SharedHistogram latency;
+};
+#endif
+
+struct ShardedBackend {
+    ShardedCounter submitted, completed;
+    ShardedGauge active;
+    ShardedHistogram latency{kLatencyBounds};
+};
+
+template <typename Backend>
+double run(Backend& m, size_t threads, uint64_t jobs_per_thread) {
+    std::atomic<bool> go{false};
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t]() {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            double latency = 0.001 * static_cast<double>(t + 1);
+            for (uint64_t i = 0; i < jobs_per_thread; ++i) {
+                m.submitted.Increment();
+                m.active.Increment();
+                m.completed.Increment();
+                m.active.Decrement();
+                m.latency.Observe(latency);
+            }
+        });
+    }
+    const auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& th : pool) {
+        th.join();
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const char* name, size_t threads, uint64_t jobs_per_thread, double seconds) {
+    const double jobs = static_cast<double>(threads * jobs_per_thread);
+    std::cout << "  " << name
+              << " jobs_per_sec=" << jobs / (seconds > 0 ? seconds : 1e-9)
+              << " ns_per_job_per_thread=" << seconds * 1e9 / jobs * static_cast<double>(threads)
+              << "\n";
+}
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> thread_counts = {1, 2, 4, std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 8};
+    uint64_t jobs_per_thread = 2000000;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string key = argv[i];
+        if (key == "--threads" && i + 1 < argc) {
+            thread_counts.clear();
+            std::stringstream ss(argv[++i]);
+            std::string item;
+            while (std::getline(ss, item, ',')) {
+                const size_t v = static_cast<size_t>(std::strtoull(item.c_str(), nullptr, 10));
+                if (v > 0) thread_counts.push_back(v);
+            }
+        } else if (key == "--jobs" && i + 1 < argc) {
+            jobs_per_thread = std::strtoull(argv[++i], nullptr, 10);
+        } else {
+            std::cout << "Usage: " << argv[0] << " [--threads 1,2,4,8] [--jobs N per thread]\n";
+            return key == "--help" || key == "-h" ? 0 : 2;
+        }
+    }
+    if (thread_counts.empty()) thread_counts = {1};
+    if (jobs_per_thread == 0) jobs_per_thread = 1;
+
+    std::cout << "=== Metrics Update Benchmark ===\n";
+#ifdef METRICS_BENCH_HAVE_PROMETHEUS
+    std::cout << "shared backend: prometheus-cpp\n\n";
+#else
+    std::cout << "shared backend: prometheus-cpp model (library not found at build time)\n\n";
+#endif
+
+    for (size_t threads : thread_counts) {
+        std::cout << "threads=" << threads << " jobs/thread=" << jobs_per_thread << "\n";
+        {
+            DisabledBackend m;
+            report("disabled", threads, jobs_per_thread, run(m, threads, jobs_per_thread));
+        }
+        {
+            SharedBackend m;
+            report("shared  ", threads, jobs_per_thread, run(m, threads, jobs_per_thread));
+        }
+        {
+            ShardedBackend m;
+            report("sharded ", threads, jobs_per_thread, run(m, threads, jobs_per_thread));
+            if (m.completed.Value() != static_cast<double>(threads * jobs_per_thread)) {
+                std::cerr << "sharded count mismatch\n";
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,234 @@
+// micro_bench.cpp
+// Google Benchmark micro-benchmarks for JobQueue and ThreadPool primitives.
+//
+// - JobQueue push+pop and push+try_pop at increasing heap depth (single thread)
+// - JobQueue reprioritize by handle at increasing heap depth
+// - JobQueue throughput with P producers and C consumers
+// - ThreadPool submit (fire-and-forget, future and tagged) and the retry path, per batch
+//
+// Metrics are stubbed (DISABLE_METRICS) and logging is off, so the numbers cover the
+// queue and pool only. Write JSON for compare_bench.py with:
+//   ./micro_bench --benchmark_out=base.json --benchmark_out_format=json
+
+#include "JobQueue.hpp"
+#include "ThreadPool.hpp"
+
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr int kBatch = 1024; // jobs per ThreadPool iteration
+
+JobQueue::Job make_job(int id, int priority) {
+    JobMetadata meta(id, "micro");
+    meta.priority = priority;
+    return JobQueue::Job(std::move(meta), []() {});
+}
+
+// Pre-fills the queue to state.range(0) jobs with random priorities, then measures one
+// push and one pop at that depth per iteration.
+void BM_JobQueue_PushPop(benchmark::State& state) {
+    const auto depth = static_cast<int>(state.range(0));
+    JobQueue queue(static_cast<size_t>(depth) + 1);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> priority(0, 20);
+    for (int i = 0; i < depth; ++i) {
+        queue.push(make_job(i, priority(rng)));
+    }
+    for (auto _ : state) {
+        queue.push(make_job(0, priority(rng)));
+        benchmark::DoNotOptimize(queue.pop());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_JobQueue_PushPop)->Arg(0)->Arg(64)->Arg(1024)->Arg(16384);
+
+void BM_JobQueue_PushTryPop(benchmark::State& state) {
+    const auto depth = static_cast<int>(state.range(0));
+    JobQueue queue(static_cast<size_t>(depth) + 1);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> priority(0, 20);
+    for (int i = 0; i < depth; ++i) {
+        queue.push(make_job(i, priority(rng)));
+    }
+    JobQueue::Job job;
+    for (auto _ : state) {
+        queue.push(make_job(0, priority(rng)));
+        benchmark::DoNotOptimize(queue.try_pop(job));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_JobQueue_PushTryPop)->Arg(0)->Arg(1024);
+
+// Moves one job with a handle between two priorities at depth state.range(0).
+void BM_JobQueue_Reprioritize(benchmark::State& state) {
+    const auto depth = static_cast<int>(state.range(0));
+    JobQueue queue(static_cast<size_t>(depth) + 1);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> priority(0, 20);
+    std::uniform_int_distribution<int> pick(0, std::max(0, depth - 1));
+    for (int i = 0; i < depth; ++i) {
+        auto job = make_job(i, priority(rng));
+        job.metadata.handle = static_cast<uint64_t>(i) + 1;
+        queue.push(std::move(job));
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(queue.reprioritize(static_cast<uint64_t>(pick(rng)) + 1, priority(rng)));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_JobQueue_Reprioritize)->Arg(64)->Arg(1024)->Arg(16384);
+
+// Each iteration moves range(2) jobs from range(0) producers to range(1) consumers
+// through a bounded queue of 1024 and drains it through shutdown.
+void BM_JobQueue_ProducersConsumers(benchmark::State& state) {
+    const auto producers = static_cast<int>(state.range(0));
+    const auto consumers = static_cast<int>(state.range(1));
+    const auto jobs = static_cast<int>(state.range(2));
+    for (auto _ : state) {
+        JobQueue queue(1024);
+        std::vector<std::thread> threads;
+        for (int c = 0; c < consumers; ++c) {
+            threads.emplace_back([&queue]() {
+                while (queue.pop().metadata.id != -1) {
+                }
+            });
+        }
+        std::vector<std::thread> producer_threads;
+        for (int p = 0; p < producers; ++p) {
+            producer_threads.emplace_back([&queue, p, producers, jobs]() {
+                for (int i = p; i < jobs; i += producers) {
+                    queue.push(make_job(i, i % 8));
+                }
+            });
+        }
+        for (auto& t : producer_threads) t.join();
+        queue.shutdown();
+        for (auto& t : threads) t.join();
+    }
+    state.SetItemsProcessed(state.iterations() * jobs);
+}
+BENCHMARK(BM_JobQueue_ProducersConsumers)
+    ->ArgNames({"producers", "consumers", "jobs"})
+    ->Args({1, 1, 20000})
+    ->Args({1, 4, 20000})
+    ->Args({4, 1, 20000})
+    ->Args({2, 2, 20000})
+    ->Args({4, 4, 20000})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+void wait_for(const std::atomic<int>& done, int target) {
+    while (done.load(std::memory_order_acquire) < target) {
+        std::this_thread::yield();
+    }
+}
+
+// Submits kBatch empty jobs and waits for all of them, on a pool of range(0) workers.
+void BM_ThreadPool_Submit(benchmark::State& state) {
+    ThreadPool pool(static_cast<size_t>(state.range(0)), kBatch);
+    std::atomic<int> done{0};
+    int expected = 0;
+    for (auto _ : state) {
+        for (int i = 0; i < kBatch; ++i) {
+            JobMetadata meta(i, "micro_submit");
+            meta.allow_retry = false;
+            pool.submit(std::move(meta), std::function<void()>([&done]() {
+                done.fetch_add(1, std::memory_order_release);
+            }));
+        }
+        expected += kBatch;
+        wait_for(done, expected);
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+    pool.shutdown();
+}
+BENCHMARK(BM_ThreadPool_Submit)->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+void BM_ThreadPool_SubmitFuture(benchmark::State& state) {
+    ThreadPool pool(static_cast<size_t>(state.range(0)), kBatch);
+    std::vector<std::future<int>> futures;
+    futures.reserve(kBatch);
+    for (auto _ : state) {
+        for (int i = 0; i < kBatch; ++i) {
+            JobMetadata meta(i, "micro_future");
+            meta.allow_retry = false;
+            futures.push_back(pool.submit(std::move(meta), [i]() { return i; }));
+        }
+        for (auto& f : futures) {
+            benchmark::DoNotOptimize(f.get());
+        }
+        futures.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+    pool.shutdown();
+}
+BENCHMARK(BM_ThreadPool_SubmitFuture)->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// Same batch as SubmitFuture, collected out of order through a CompletionQueue.
+void BM_ThreadPool_SubmitTagged(benchmark::State& state) {
+    ThreadPool pool(static_cast<size_t>(state.range(0)), kBatch);
+    CompletionQueue<int> completions(kBatch);
+    std::vector<CompletionQueue<int>::Completion> done;
+    done.reserve(kBatch);
+    for (auto _ : state) {
+        for (int i = 0; i < kBatch; ++i) {
+            JobMetadata meta(i, "micro_tagged");
+            meta.allow_retry = false;
+            pool.submit_tagged(std::move(meta), completions, static_cast<uint64_t>(i), [i]() { return i; });
+        }
+        while (done.size() < static_cast<size_t>(kBatch)) {
+            completions.wait(done, kBatch, std::chrono::milliseconds(10));
+        }
+        done.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+    pool.shutdown();
+}
+BENCHMARK(BM_ThreadPool_SubmitTagged)->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// Every job throws on its first attempt and succeeds on the retry (no backoff).
+void BM_ThreadPool_RetryOnce(benchmark::State& state) {
+    ThreadPool pool(static_cast<size_t>(state.range(0)), 2 * kBatch); // room for requeued retries
+    std::atomic<int> done{0};
+    int expected = 0;
+    for (auto _ : state) {
+        for (int i = 0; i < kBatch; ++i) {
+            JobMetadata meta(i, "micro_retry", 1);
+            auto attempts = std::make_shared<int>(0);
+            pool.submit(std::move(meta), std::function<void()>([&done, attempts]() {
+                if ((*attempts)++ == 0) {
+                    throw std::runtime_error("first attempt fails");
+                }
+                done.fetch_add(1, std::memory_order_release);
+            }));
+        }
+        expected += kBatch;
+        wait_for(done, expected);
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+    pool.shutdown();
+}
+BENCHMARK(BM_ThreadPool_RetryOnce)->ArgName("threads")->Arg(1)->Arg(2)->UseRealTime()->Unit(benchmark::kMicrosecond);
+}
+
+int main(int argc, char** argv) {
+    spdlog::set_level(spdlog::level::off);
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,120 @@
+// snapshot_bench.cpp
+// Warm-start benchmark for LRUCache snapshots.
+//
+// Fills an LRUCache<std::string, uint64_t>, saves it, then compares:
+// - lazy restore: mmap + header check, values decoded on first access
+// - full materialize: replay every record into the cache
+// Default size is 1M entries.
+
+#include "LRUCache.hpp"
+#include "LRUCacheSnapshot.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Freeing the build cache leaves ~1M small chunks that the allocator consolidates on the
+// next large allocation. Trigger that outside the timed region; a freshly started process
+// would not pay it during restore.
+static void settle_allocator(size_t bytes) {
+    std::vector<char> scratch(bytes);
+    volatile char sink = scratch[bytes - 1];
+    (void)sink;
+}
+
+static void print_usage(const char* exe) {
+    std::cout
+        << "Usage: " << exe << " [options]\n\n"
+        << "Options:\n"
+        << "  --entries N         Cache entries to snapshot (default: 1000000)\n"
+        << "  --path FILE         Snapshot file (default: snapshot_bench.bin)\n"
+        << "  --keep              Keep the snapshot file after the run\n"
+        << "  --help              Show this message\n";
+}
+
+int main(int argc, char** argv) {
+    size_t entries = 1000000;
+    std::string path = "snapshot_bench.bin";
+    bool keep = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string key = argv[i];
+        if (key == "--help" || key == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (key == "--entries" && i + 1 < argc) {
+            entries = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else if (key == "--path" && i + 1 < argc) {
+            path = argv[++i];
+        } else if (key == "--keep") {
+            keep = true;
+        } else {
+            std::cerr << "Unknown option: " << key << "\n";
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (entries == 0) entries = 1;
+
+    std::cout << "=== LRUCache Snapshot Benchmark ===\n";
+    std::cout << "entries=" << entries << " path=" << path << "\n\n";
+
+    auto t = Clock::now();
+    {
+        LRUCache<std::string, uint64_t> cache(entries);
+        for (size_t i = 0; i < entries; ++i) {
+            cache.put("key_" + std::to_string(i), static_cast<uint64_t>(i) * 2654435761ULL);
+        }
+        const double fill_ms = ms_since(t);
+
+        t = Clock::now();
+        save_snapshot(cache, path);
+        const double save_ms = ms_since(t);
+
+        std::cout << "Build:\n";
+        std::cout << "  fill_ms=" << fill_ms << "\n";
+        std::cout << "  save_ms=" << save_ms << "\n";
+        std::cout << "  file_bytes=" << std::filesystem::file_size(path) << "\n";
+    }
+
+    settle_allocator(entries);
+
+    LRUCache<std::string, uint64_t> lazy(entries);
+    t = Clock::now();
+    auto snapshot = LRUCacheSnapshot<std::string, uint64_t>::attach(lazy, path);
+    const double open_ms = ms_since(t);
+
+    t = Clock::now();
+    uint64_t value = 0;
+    const bool hit = lazy.get("key_" + std::to_string(entries / 2), value);
+    const double first_hit_us = ms_since(t) * 1000.0;
+
+    t = Clock::now();
+    const size_t replayed = snapshot->materialize(lazy);
+    const double materialize_ms = ms_since(t);
+
+    std::cout << "Lazy restore (startup cost):\n";
+    std::cout << "  open_ms=" << open_ms << "\n";
+    std::cout << "  first_hit_us=" << first_hit_us << (hit ? "" : " (miss!)") << "\n";
+    std::cout << "Full materialize (background cost):\n";
+    std::cout << "  materialize_ms=" << materialize_ms << "\n";
+    std::cout << "  replayed=" << replayed << " cached=" << lazy.size() << "\n";
+
+    snapshot.reset();
+    lazy.set_backing(nullptr);
+    if (!keep) {
+        std::remove(path.c_str());
+    }
+    return (hit && lazy.size() == entries) ? 0 : 1;
+}
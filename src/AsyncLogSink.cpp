@@ -0,0 +1,136 @@
+#include "AsyncLogSink.hpp"
+#include <algorithm>
+#include <cstring>
+
+AsyncLogSink::AsyncLogSink(std::vector<spdlog::sink_ptr> sinks, size_t capacity,
+                           std::chrono::milliseconds idle_sleep)
+    : sinks_(std::move(sinks)), idle_sleep_(idle_sleep) {
+    size_t rounded = 2;
+    while (rounded < capacity) rounded <<= 1;
+    slots_.reset(new Slot[rounded]);
+    mask_ = rounded - 1;
+    for (size_t i = 0; i < rounded; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    flusher_ = std::thread(&AsyncLogSink::flusher_loop, this);
+}
+
+AsyncLogSink::~AsyncLogSink() {
+    stop();
+}
+
+// Bounded MPMC ring (Vyukov): a slot whose sequence equals the claim position is free.
+void AsyncLogSink::log(const spdlog::details::log_msg& msg) {
+    if (!running_.load(std::memory_order_relaxed)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    while (true) {
+        slot = &slots_[pos & mask_];
+        const uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+        const int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            dropped_.fetch_add(1, std::memory_order_relaxed); // full: never block the caller
+            return;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->time = msg.time;
+    slot->thread_id = msg.thread_id;
+    slot->level = msg.level;
+    slot->logger_name_size = static_cast<uint16_t>(std::min(msg.logger_name.size(), kLoggerNameBytes));
+    std::memcpy(slot->logger_name, msg.logger_name.data(), slot->logger_name_size);
+    slot->size = static_cast<uint16_t>(std::min(msg.payload.size(), kMessageBytes));
+    std::memcpy(slot->payload, msg.payload.data(), slot->size);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool AsyncLogSink::try_pop(Slot*& slot) {
+    const uint64_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    slot = &slots_[pos & mask_];
+    return slot->sequence.load(std::memory_order_acquire) == pos + 1;
+}
+
+size_t AsyncLogSink::drain() {
+    size_t forwarded = 0;
+    Slot* slot = nullptr;
+    while (try_pop(slot)) {
+        spdlog::details::log_msg msg(slot->time, spdlog::source_loc{},
+                                     spdlog::string_view_t(slot->logger_name, slot->logger_name_size),
+                                     slot->level, spdlog::string_view_t(slot->payload, slot->size));
+        msg.thread_id = slot->thread_id;
+        for (auto& sink : sinks_) {
+            if (sink->should_log(msg.level)) sink->log(msg);
+        }
+
+        const uint64_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+        ++forwarded;
+    }
+
+    const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reported_dropped_) {
+        const std::string text = "async log ring full: dropped " + std::to_string(dropped - reported_dropped_) +
+                                 " messages";
+        spdlog::details::log_msg msg(spdlog::string_view_t(), spdlog::level::warn, text);
+        for (auto& sink : sinks_) {
+            if (sink->should_log(msg.level)) sink->log(msg);
+        }
+        reported_dropped_ = dropped;
+    }
+
+    if (forwarded > 0) {
+        for (auto& sink : sinks_) sink->flush();
+    }
+    flushed_pos_.store(dequeue_pos_.load(std::memory_order_relaxed), std::memory_order_release);
+    return forwarded;
+}
+
+void AsyncLogSink::flusher_loop() {
+    while (running_.load(std::memory_order_acquire)) {
+        if (drain() == 0) {
+            std::this_thread::sleep_for(idle_sleep_);
+        }
+    }
+    drain();
+}
+
+void AsyncLogSink::flush() {
+    const uint64_t target = enqueue_pos_.load(std::memory_order_acquire);
+    while (flusher_.joinable() && running_.load(std::memory_order_acquire) &&
+           flushed_pos_.load(std::memory_order_acquire) < target) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void AsyncLogSink::set_pattern(const std::string& pattern) {
+    for (auto& sink : sinks_) sink->set_pattern(pattern);
+}
+
+void AsyncLogSink::set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) {
+    for (auto& sink : sinks_) sink->set_formatter(sink_formatter->clone());
+}
+
+void AsyncLogSink::stop() {
+    running_.store(false, std::memory_order_release);
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+}
+
+std::shared_ptr<AsyncLogSink> install_async_default_logger(size_t capacity) {
+    auto current = spdlog::default_logger();
+    auto sink = std::make_shared<AsyncLogSink>(current->sinks(), capacity);
+    auto logger = std::make_shared<spdlog::logger>(current->name(), sink);
+    logger->set_level(current->level());
+    spdlog::set_default_logger(logger);
+    return sink;
+}
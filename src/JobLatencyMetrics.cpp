@@ -0,0 +1,65 @@
+#include "JobLatencyMetrics.hpp"
+
+namespace {
+struct LastHit {
+    const JobLatencyMetrics* owner = nullptr;
+    std::string name;
+    int priority = 0;
+    int index = 0;
+};
+}
+
+JobLatencyMetrics::JobLatencyMetrics() {
+    series_[0].reset(new Series());
+    series_[0]->job = "other";
+    series_[0]->priority_label = "other";
+    count_.store(1, std::memory_order_release);
+}
+
+int JobLatencyMetrics::find(const std::string& name, int priority, size_t limit) const {
+    for (size_t i = 1; i < limit; ++i) {
+        const Series& s = *series_[i];
+        if (s.priority == priority && s.job == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int JobLatencyMetrics::resolve(const std::string& name, int priority) {
+    thread_local LastHit last;
+    if (last.owner == this && last.priority == priority && last.name == name) {
+        return last.index;
+    }
+
+    // Published entries are immutable, so the scan needs no lock.
+    int index = find(name, priority, size());
+    if (index < 0) {
+        std::lock_guard<std::mutex> lock(append_mutex_);
+        const size_t count = count_.load(std::memory_order_relaxed);
+        index = find(name, priority, count);
+        if (index < 0) {
+            bool known_name = false;
+            for (size_t i = 1; i < count && !known_name; ++i) {
+                known_name = series_[i]->job == name;
+            }
+            if (count == kMaxSeries || (!known_name && job_names_ == kMaxJobNames)) {
+                index = 0;
+            } else {
+                series_[count].reset(new Series());
+                series_[count]->job = name;
+                series_[count]->priority = priority;
+                series_[count]->priority_label = std::to_string(priority);
+                job_names_ += known_name ? 0 : 1;
+                count_.store(count + 1, std::memory_order_release);
+                index = static_cast<int>(count);
+            }
+        }
+    }
+
+    last.owner = this;
+    last.name = name;
+    last.priority = priority;
+    last.index = index;
+    return index;
+}
@@ -0,0 +1,159 @@
+#include "JobProfiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ostream>
+#include <time.h>
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+int64_t thread_cpu_ns() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec ts{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+#endif
+    return 0;
+}
+
+struct LastHit {
+    std::string job;
+    size_t slot = 0;
+    bool valid = false;
+};
+}
+
+JobProfiler& JobProfiler::instance() {
+    // Leaked on purpose: workers may still record during static destruction.
+    static JobProfiler* profiler = new JobProfiler();
+    return *profiler;
+}
+
+JobProfiler::JobProfiler() {
+    slots_[0].reset(new Slot());
+    slots_[0]->job = "other";
+    count_.store(1, std::memory_order_release);
+}
+
+void JobProfiler::enable(bool context_switches) {
+    context_switches_.store(context_switches, std::memory_order_relaxed);
+    enabled_.store(true, std::memory_order_release);
+}
+
+void JobProfiler::disable() {
+    enabled_.store(false, std::memory_order_release);
+}
+
+JobProfiler::Sample JobProfiler::begin() const {
+    Sample sample;
+    sample.wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    sample.cpu_ns = thread_cpu_ns();
+#if defined(__linux__) && defined(RUSAGE_THREAD)
+    if (context_switches()) {
+        rusage usage{};
+        if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+            sample.voluntary_switches = usage.ru_nvcsw;
+            sample.involuntary_switches = usage.ru_nivcsw;
+            sample.switches_sampled = true;
+        }
+    }
+#endif
+    return sample;
+}
+
+size_t JobProfiler::resolve(const std::string& job) {
+    // The profiler is a singleton, so one cached name per thread is enough.
+    thread_local LastHit last;
+    if (last.valid && last.job == job) {
+        return last.slot;
+    }
+
+    size_t slot = 0;
+    bool found = false;
+    for (size_t i = 1, n = count_.load(std::memory_order_acquire); i < n && !found; ++i) {
+        if (slots_[i]->job == job) {
+            slot = i;
+            found = true;
+        }
+    }
+    if (!found) {
+        std::lock_guard<std::mutex> lock(append_mutex_);
+        const size_t n = count_.load(std::memory_order_relaxed);
+        for (size_t i = 1; i < n && !found; ++i) {
+            if (slots_[i]->job == job) {
+                slot = i;
+                found = true;
+            }
+        }
+        if (!found && n <= kMaxJobNames) {
+            slots_[n].reset(new Slot());
+            slots_[n]->job = job;
+            count_.store(n + 1, std::memory_order_release);
+            slot = n;
+        }
+    }
+
+    last.job = job;
+    last.slot = slot;
+    last.valid = true;
+    return slot;
+}
+
+void JobProfiler::record(const std::string& job, const Sample& before) {
+    const Sample after = begin();
+    Slot& slot = *slots_[resolve(job)];
+    slot.cpu.ObserveNanos(after.cpu_ns - before.cpu_ns);
+    slot.wall_ns.Increment(after.wall_ns - before.wall_ns);
+    if (before.switches_sampled && after.switches_sampled) {
+        slot.voluntary.Increment(after.voluntary_switches - before.voluntary_switches);
+        slot.involuntary.Increment(after.involuntary_switches - before.involuntary_switches);
+    }
+}
+
+std::vector<JobProfiler::Profile> JobProfiler::profile() const {
+    std::vector<Profile> out;
+    for (size_t i = 0, n = count_.load(std::memory_order_acquire); i < n; ++i) {
+        const Slot& slot = *slots_[i];
+        Profile p;
+        p.job = slot.job;
+        p.cpu = slot.cpu.snapshot();
+        if (p.cpu.count == 0) continue;
+        p.wall_seconds = slot.wall_ns.Value() * 1e-9;
+        p.voluntary_switches = static_cast<uint64_t>(slot.voluntary.Value());
+        p.involuntary_switches = static_cast<uint64_t>(slot.involuntary.Value());
+        out.push_back(std::move(p));
+    }
+    std::sort(out.begin(), out.end(), [](const Profile& a, const Profile& b) { return a.cpu.sum > b.cpu.sum; });
+    return out;
+}
+
+void JobProfiler::dump_profile(std::ostream& out) const {
+    const auto profiles = profile();
+    double total_cpu = 0.0;
+    for (const auto& p : profiles) {
+        total_cpu += p.cpu.sum;
+    }
+
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-24s %10s %12s %12s %12s %7s %8s %10s %10s\n", "job", "count",
+                  "cpu_total_ms", "cpu_mean_us", "cpu_p99_us", "share", "cpu/wall", "vol_csw", "invol_csw");
+    out << line;
+    for (const auto& p : profiles) {
+        const double count = static_cast<double>(p.cpu.count);
+        std::snprintf(line, sizeof(line), "%-24.24s %10llu %12.3f %12.2f %12.2f %6.1f%% %8.2f %10llu %10llu\n",
+                      p.job.c_str(), static_cast<unsigned long long>(p.cpu.count), p.cpu.sum * 1e3,
+                      p.cpu.sum / count * 1e6, p.cpu.quantile(0.99) * 1e6,
+                      total_cpu > 0 ? 100.0 * p.cpu.sum / total_cpu : 0.0,
+                      p.wall_seconds > 0 ? p.cpu.sum / p.wall_seconds : 0.0,
+                      static_cast<unsigned long long>(p.voluntary_switches),
+                      static_cast<unsigned long long>(p.involuntary_switches));
+        out << line;
+    }
+    if (!context_switches()) {
+        out << "(context switches not sampled; enable(true) to record them)\n";
+    }
+}
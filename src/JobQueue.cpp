@@ -1,51 +1,453 @@
 #include "JobQueue.hpp"
-#include <spdlog/spdlog.h>
+#include "JobLog.hpp"
+#include <cmath>
+
+namespace {
+// Retries are never merge targets: callers coalesce into work that has not started yet.
+bool coalescable(const JobQueue::Job& job) {
+    return job.metadata.coalesce_key != 0 && job.metadata.current_retry == 0;
+}
+
+std::chrono::steady_clock::time_point deadline_of(const JobMetadata& metadata) {
+    return metadata.timeout.count() > 0 ? metadata.enqueue_time + metadata.timeout
+                                        : std::chrono::steady_clock::time_point::max();
+}
+
+// cv.wait(lock, ready), additionally counting parks, their duration and wakeups that
+// found ready() still false. Called with the lock held, so stats need no atomics.
+template <typename Predicate>
+void wait_until_ready(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, Predicate ready,
+                      uint64_t& waits, uint64_t& wait_ns, uint64_t& spurious) {
+#ifdef JOBQUEUE_CONTENTION_STATS
+    if (ready()) return;
+    ++waits;
+    const uint64_t start = contention::now_ns();
+    cv.wait(lock);
+    while (!ready()) {
+        ++spurious;
+        cv.wait(lock);
+    }
+    wait_ns += contention::now_ns() - start;
+#else
+    (void)waits;
+    (void)wait_ns;
+    (void)spurious;
+    cv.wait(lock, ready);
+#endif
+}
+
+// wait_until_ready() that gives up at deadline; returns ready().
+template <typename Predicate>
+bool wait_until_ready_or(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+                         std::chrono::steady_clock::time_point deadline, Predicate ready,
+                         uint64_t& waits, uint64_t& wait_ns, uint64_t& spurious) {
+#ifdef JOBQUEUE_CONTENTION_STATS
+    if (ready()) return true;
+    if (std::chrono::steady_clock::now() >= deadline) return false;
+    ++waits;
+    const uint64_t start = contention::now_ns();
+    bool ok = false;
+    while (cv.wait_until(lock, deadline) != std::cv_status::timeout) {
+        if ((ok = ready())) break;
+        ++spurious;
+    }
+    wait_ns += contention::now_ns() - start;
+    return ok || ready();
+#else
+    (void)waits;
+    (void)wait_ns;
+    (void)spurious;
+    return cv.wait_until(lock, deadline, ready);
+#endif
+}
+}
 
 JobQueue::JobQueue(size_t max_size)
     : max_queue_size_(max_size) {}
 
 bool JobQueue::push(Job job) { // pushing A Job struct(contains: metadata, std::function<void()> task, NOT a thread, just a function object stored in memory.
-    std::unique_lock<std::mutex> lock(mutex_);
-    not_full_cv_.wait(lock, [this]() {
-        return queue_.size() < max_queue_size_ || shutdown_;
-    });
+    // Retries come through here: they were admitted once already, so shedding skips them.
+    std::optional<Job> evicted;
+    return push_impl(job, std::chrono::steady_clock::time_point::max(), OverflowPolicy::Block, evicted, false,
+                     false) == PushStatus::Ok;
+}
+
+JobQueue::PushStatus JobQueue::push(Job& job, std::chrono::steady_clock::time_point deadline,
+                                    OverflowPolicy policy, std::optional<Job>& evicted) {
+    return push_impl(job, deadline, policy, evicted, true, false);
+}
 
-    if (shutdown_) return false;
+JobQueue::PushStatus JobQueue::reserve(Job& job, std::chrono::steady_clock::time_point deadline,
+                                       OverflowPolicy policy, std::optional<Job>& evicted) {
+    return push_impl(job, deadline, policy, evicted, true, true);
+}
+
+JobQueue::PushStatus JobQueue::push_impl(Job& job, std::chrono::steady_clock::time_point deadline,
+                                         OverflowPolicy policy, std::optional<Job>& evicted, bool admission,
+                                         bool reserving) {
+    auto lock = acquire();
+    if (admission && !reserving && !shutdown_ && coalescable(job) && merge_queued(job)) {
+        return PushStatus::Merged; // adds no work, so neither room nor shedding applies
+    }
+    if (admission && job.metadata.priority >= shedding_.shed_priority && !shutdown_) {
+        recheck_dropping(std::chrono::steady_clock::now());
+        if (dropping_) return PushStatus::Overloaded;
+    }
+    auto has_room = [this]() { return queue_.size() + reserved_ < max_queue_size_ || shutdown_; };
+    bool room = true;
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+        wait_until_ready(not_full_cv_, lock, has_room,
+                         stats_.producer_waits, stats_.producer_block_ns, stats_.spurious_wakeups);
+    } else {
+        const bool waited = !has_room() && std::chrono::steady_clock::now() < deadline;
+        room = wait_until_ready_or(not_full_cv_, lock, deadline, has_room,
+                                   stats_.producer_waits, stats_.producer_block_ns, stats_.spurious_wakeups);
+        if (!room && !evict_for(job, policy, evicted)) {
+            return waited ? PushStatus::Timeout : PushStatus::Full;
+        }
+    }
+
+    if (shutdown_) return PushStatus::Shutdown;
+    if (reserving) {
+        ++reserved_;
+        return PushStatus::Ok;
+    }
+    insert(job);
+    return PushStatus::Ok;
+}
+
+bool JobQueue::requeue(Job& job) {
+    auto lock = acquire();
+    --reserved_;
+    if (shutdown_) {
+        not_full_cv_.notify_one();
+        return false;
+    }
+    insert(job);
+    return true;
+}
+
+void JobQueue::release() {
+    {
+        auto lock = acquire();
+        --reserved_;
+    }
+    not_full_cv_.notify_one();
+}
+
+void JobQueue::insert(Job& job) {
+    const int priority = job.metadata.priority;
+    remember(job);
+    if (batch_waiting_ > 0) batch_cv_.notify_all(); // a key's job to take, or other work to yield to
     queue_.push_back(std::move(job));
-    std::push_heap(queue_.begin(), queue_.end(), compare_);
-    spdlog::info("Queue size after push: {}", queue_.size());
+    place(queue_.size() - 1);
+    sift_up(queue_.size() - 1);
+    JOB_LOG_DEBUG("Queue size after push: {}", queue_.size());
     not_empty_cv_.notify_one();//Wakes up one thread waiting on cv_
+    if (lane_waiting_ > 0 && (priority <= lane_max_priority_ || lane_waiting_ > lane_min_idle_)) {
+        lane_cv_.notify_one();
+    }
+}
+
+// The queued job keeps its place in line; a more urgent priority moves it up the heap.
+// Finding it is a linear scan, paid only by submits whose key is already queued.
+bool JobQueue::merge_queued(Job& job) {
+    const uint64_t key = job.metadata.coalesce_key;
+    if (coalescing_.count(key) == 0) return false;
+    const auto it = std::find_if(queue_.begin(), queue_.end(), [key](const Job& queued) {
+        return coalescable(queued) && queued.metadata.coalesce_key == key;
+    });
+    if (it == queue_.end()) return false;
+
+    JobMetadata& queued = it->metadata;
+    const auto deadline = deadline_of(job.metadata);
+    if (deadline < deadline_of(queued)) {
+        queued.timeout = std::max(std::chrono::milliseconds(1),
+                                  std::chrono::ceil<std::chrono::milliseconds>(deadline - queued.enqueue_time));
+    }
+    if (job.on_terminal_failure) {
+        if (it->on_terminal_failure) {
+            it->on_terminal_failure = [first = std::move(it->on_terminal_failure),
+                                       second = std::move(job.on_terminal_failure)](std::exception_ptr ex) {
+                first(ex);
+                second(ex);
+            };
+        } else {
+            it->on_terminal_failure = std::move(job.on_terminal_failure);
+        }
+    }
+    job.shared_state = it->shared_state;
+    const int priority = job.metadata.priority;
+    if (priority < queued.priority) {
+        untrack_sheddable(*it);
+        queued.priority = priority;
+        track_sheddable(*it);
+        sift_up(static_cast<size_t>(it - queue_.begin()));
+        if (lane_waiting_ > 0 && priority <= lane_max_priority_) lane_cv_.notify_one();
+    }
+    return true;
+}
+
+void JobQueue::remember(const Job& job) {
+    if (coalescable(job)) ++coalescing_[job.metadata.coalesce_key];
+    if (job.metadata.batch_key != 0) ++batch_queued_[job.metadata.batch_key];
+    track_sheddable(job);
+}
+
+void JobQueue::forget(const Job& job) {
+    if (coalescable(job)) {
+        const auto it = coalescing_.find(job.metadata.coalesce_key);
+        if (--it->second == 0) coalescing_.erase(it);
+    }
+    if (job.metadata.batch_key != 0) --batch_queued_[job.metadata.batch_key];
+    untrack_sheddable(job);
+}
+
+// Retries keep their first enqueue_time, so only first attempts say how old the backlog is.
+bool JobQueue::sheddable(const Job& job) const {
+    return shedding_.target.count() > 0 && job.metadata.current_retry == 0 &&
+           job.metadata.priority >= shedding_.shed_priority;
+}
+
+void JobQueue::track_sheddable(const Job& job) {
+    if (sheddable(job)) sheddable_enqueued_.insert(job.metadata.enqueue_time);
+}
+
+void JobQueue::untrack_sheddable(const Job& job) {
+    if (sheddable(job)) sheddable_enqueued_.erase(sheddable_enqueued_.find(job.metadata.enqueue_time));
+}
+
+// Linear scan: only runs on overflow or while shedding.
+std::vector<JobQueue::Job>::iterator JobQueue::lowest_priority_oldest() {
+    auto victim = queue_.begin();
+    for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+        if (it->metadata.priority > victim->metadata.priority ||
+            (it->metadata.priority == victim->metadata.priority &&
+             it->metadata.enqueue_time < victim->metadata.enqueue_time)) {
+            victim = it;
+        }
+    }
+    return victim;
+}
+
+JobQueue::Job JobQueue::take_at(size_t index) {
+    Job job = std::move(queue_[index]);
+    if (job.metadata.handle != 0) positions_.erase(job.metadata.handle);
+    forget(job);
+    if (index + 1 < queue_.size()) {
+        queue_[index] = std::move(queue_.back());
+        queue_.pop_back();
+        place(index);
+        // The moved-in job can belong above or below its new slot.
+        sift_up(index);
+        sift_down(index);
+    } else {
+        queue_.pop_back();
+    }
+    return job;
+}
+
+// Both sifts move the job through a hole instead of swapping, one move per level.
+void JobQueue::sift_up(size_t index) {
+    if (index == 0 || !compare_(queue_[(index - 1) / 2], queue_[index])) return;
+    Job moving = std::move(queue_[index]);
+    while (index > 0) {
+        const size_t parent = (index - 1) / 2;
+        if (!compare_(queue_[parent], moving)) break;
+        queue_[index] = std::move(queue_[parent]);
+        place(index);
+        index = parent;
+    }
+    queue_[index] = std::move(moving);
+    place(index);
+}
+
+void JobQueue::sift_down(size_t index) {
+    const size_t size = queue_.size();
+    auto larger_child = [&](size_t i) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < size && compare_(queue_[child], queue_[child + 1])) ++child;
+        return child;
+    };
+    if (2 * index + 1 >= size || !compare_(queue_[index], queue_[larger_child(index)])) return;
+    Job moving = std::move(queue_[index]);
+    while (2 * index + 1 < size) {
+        const size_t child = larger_child(index);
+        if (!compare_(moving, queue_[child])) break;
+        queue_[index] = std::move(queue_[child]);
+        place(index);
+        index = child;
+    }
+    queue_[index] = std::move(moving);
+    place(index);
+}
+
+void JobQueue::place(size_t index) {
+    const uint64_t handle = queue_[index].metadata.handle;
+    if (handle != 0) positions_[handle] = index;
+}
+
+void JobQueue::heapify() {
+    std::make_heap(queue_.begin(), queue_.end(), compare_);
+    positions_.clear();
+    for (size_t i = 0; i < queue_.size(); ++i) place(i);
+}
+
+bool JobQueue::reprioritize(uint64_t handle, int priority) {
+    auto lock = acquire();
+    const auto found = positions_.find(handle);
+    if (found == positions_.end()) return false;
+    const size_t index = found->second;
+    const int old_priority = queue_[index].metadata.priority;
+    untrack_sheddable(queue_[index]);
+    queue_[index].metadata.priority = priority;
+    track_sheddable(queue_[index]);
+    if (priority < old_priority) {
+        sift_up(index);
+        if (lane_waiting_ > 0 && priority <= lane_max_priority_) lane_cv_.notify_one();
+    } else {
+        sift_down(index);
+    }
+    return true;
+}
+
+size_t JobQueue::reprioritize_group(uint64_t group, int priority) {
+    auto lock = acquire();
+    size_t changed = 0;
+    for (auto& job : queue_) {
+        if (job.metadata.group == group && job.metadata.priority != priority) {
+            untrack_sheddable(job);
+            job.metadata.priority = priority;
+            track_sheddable(job);
+            ++changed;
+        }
+    }
+    if (changed > 0) {
+        heapify();
+        if (lane_waiting_ > 0 && priority <= lane_max_priority_) lane_cv_.notify_all();
+    }
+    return changed;
+}
+
+// Called full and not shut down.
+bool JobQueue::evict_for(const Job& incoming, OverflowPolicy policy, std::optional<Job>& evicted) {
+    if (policy == OverflowPolicy::Block || policy == OverflowPolicy::Reject || queue_.empty()) {
+        return false;
+    }
+    const auto victim = lowest_priority_oldest();
+    const int lowest = victim->metadata.priority;
+    if (incoming.metadata.priority > lowest ||
+        (policy == OverflowPolicy::DisplaceLower && incoming.metadata.priority == lowest)) {
+        return false;
+    }
+    evicted.emplace(take_at(static_cast<size_t>(victim - queue_.begin())));
     return true;
 }
 
-JobQueue::Job JobQueue::pop() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    not_empty_cv_.wait(lock, [this]() { return !queue_.empty() || shutdown_; });
+// CoDel control law on the wait of the job just popped. Only sheddable jobs are measured:
+// protected ones jump the heap, so their short waits say nothing about the backlog.
+// Retries keep their first enqueue_time, so they are not measured either.
+void JobQueue::control_delay(const Job& popped, std::vector<Job>& shed) {
+    const auto now = std::chrono::steady_clock::now();
+    recheck_dropping(now);
+    if (popped.metadata.current_retry > 0 || popped.metadata.priority < shedding_.shed_priority) return;
+    if (now - popped.metadata.enqueue_time < shedding_.target || queue_.empty()) {
+        first_above_ = {};
+        dropping_ = false;
+        return;
+    }
+    if (first_above_ == std::chrono::steady_clock::time_point{}) {
+        first_above_ = now + shedding_.interval;
+        return;
+    }
+    if (!dropping_) {
+        if (now < first_above_) return;
+        dropping_ = true;
+        // Back into overload soon after leaving it: resume near the previous drop rate.
+        drop_count_ = drop_count_ > 2 && now - drop_next_ < 16 * shedding_.interval ? drop_count_ - 2 : 1;
+        drop_next_ = now;
+        JOB_LOG_WARN("Queue wait above {}us for {}ms; shedding priority >= {}",
+                     shedding_.target.count(), shedding_.interval.count(), shedding_.shed_priority);
+    }
+    if (now < drop_next_) return;
+    drop_next_ = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                           shedding_.interval / std::sqrt(static_cast<double>(drop_count_)));
+    const auto victim = lowest_priority_oldest();
+    if (victim->metadata.priority < shedding_.shed_priority) return; // only protected work queued
+    shed.push_back(take_at(static_cast<size_t>(victim - queue_.begin())));
+    not_full_cv_.notify_one();
+    ++drop_count_;
+}
+
+// Leaves the dropping state once the backlog it was shedding is gone: no sheddable first
+// attempt queued, or the oldest one has waited less than target. Runs on every pop and on
+// sheddable pushes, so the state cannot outlive the overload when only protected or retry
+// jobs are popped after the last sheddable one was shed. O(1): insert() and forget() keep
+// sheddable_enqueued_ current.
+void JobQueue::recheck_dropping(std::chrono::steady_clock::time_point now) {
+    if (!dropping_) return;
+    if (sheddable_enqueued_.empty() || now - *sheddable_enqueued_.begin() < shedding_.target) {
+        first_above_ = {};
+        dropping_ = false;
+    }
+}
+
+JobQueue::Job JobQueue::pop(std::vector<Job>* shed) {
+    auto lock = acquire();
+    ++pop_waiting_;
+    wait_until_ready(not_empty_cv_, lock, [this]() { return !queue_.empty() || shutdown_; },
+                     stats_.consumer_waits, stats_.consumer_park_ns, stats_.spurious_wakeups);
+    --pop_waiting_;
 
     if (shutdown_ && queue_.empty()) {
         return Job(JobMetadata(-1, "empty"), []() {});
     }
+    return take_top(shed);
+}
+
+JobQueue::Job JobQueue::pop_lane(std::vector<Job>* shed) {
+    auto lock = acquire();
+    // Counted while here, so other lane workers know whether they may borrow.
+    ++lane_waiting_;
+    auto can_take = [this]() {
+        if (queue_.empty()) return false;
+        return queue_.front().metadata.priority <= lane_max_priority_ || lane_waiting_ - 1 >= lane_min_idle_;
+    };
+    wait_until_ready(lane_cv_, lock, [&]() { return shutdown_ || can_take(); },
+                     stats_.consumer_waits, stats_.consumer_park_ns, stats_.spurious_wakeups);
+    const bool take = can_take();
+    --lane_waiting_;
+
+    if (!take) { // shut down; shared workers drain the rest
+        return Job(JobMetadata(-1, "empty"), []() {});
+    }
+    return take_top(shed);
+}
 
-    std::pop_heap(queue_.begin(), queue_.end(), compare_);
-    Job job = std::move(queue_.back());
-    queue_.pop_back();
+JobQueue::Job JobQueue::take_top(std::vector<Job>* shed) {
+    Job job = take_at(0);
     not_full_cv_.notify_one();  // signal producer
+    if (shed != nullptr && shedding_.target.count() > 0) control_delay(job, *shed);
     return job;
 }
 
+void JobQueue::configure_lane(int max_priority, size_t min_idle) {
+    auto lock = acquire();
+    lane_max_priority_ = max_priority;
+    lane_min_idle_ = min_idle;
+}
+
 bool JobQueue::try_pop(Job& job) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = acquire();
     if (queue_.empty()) return false;
 
-    std::pop_heap(queue_.begin(), queue_.end(), compare_);
-    job = std::move(queue_.back());
-    queue_.pop_back();
+    job = take_at(0);
     not_full_cv_.notify_one();
     return true;
 }
 
 bool JobQueue::empty() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = acquire();
     return queue_.empty();
 }
 
@@ -56,10 +458,99 @@ void JobQueue::shutdown() {
     }
     not_empty_cv_.notify_all();
     not_full_cv_.notify_all();
+    lane_cv_.notify_all();
+    batch_cv_.notify_all();
 
 }
 
 bool JobQueue::is_shutdown() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = acquire();
     return shutdown_;
 }
+
+void JobQueue::set_batching(uint64_t batch_key, BatchOptions options) {
+    auto lock = acquire();
+    batching_[batch_key] = options;
+}
+
+// One pass moves the matching jobs out and one heapify() repairs the rest, so a batch
+// costs O(n) however many jobs it takes.
+void JobQueue::take_batch(std::vector<Job>& batch, int max_priority) {
+    const uint64_t key = batch.front().metadata.batch_key;
+    auto lock = acquire();
+    const auto options = batching_.find(key);
+    if (options == batching_.end()) return;
+    const size_t max_size = std::max<size_t>(1, options->second.max_size);
+    const auto linger_until = batch.front().metadata.enqueue_time + options->second.linger;
+    size_t& queued = batch_queued_[key];
+
+    while (true) {
+        if (queued > 0 && batch.size() < max_size) {
+            std::vector<Job> matching;
+            auto keep = queue_.begin();
+            for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+                if (it->metadata.batch_key == key && it->metadata.priority <= max_priority) {
+                    forget(*it);
+                    matching.push_back(std::move(*it));
+                } else {
+                    if (keep != it) *keep = std::move(*it);
+                    ++keep;
+                }
+            }
+            queue_.erase(keep, queue_.end());
+            // Heap order: take the most urgent, return the rest.
+            std::sort(matching.begin(), matching.end(), [this](const Job& a, const Job& b) { return compare_(b, a); });
+            const size_t take = std::min(matching.size(), max_size - batch.size());
+            for (size_t i = 0; i < matching.size(); ++i) {
+                if (i < take) {
+                    batch.push_back(std::move(matching[i]));
+                } else {
+                    remember(matching[i]);
+                    queue_.push_back(std::move(matching[i]));
+                }
+            }
+            heapify();
+            if (take > 0) not_full_cv_.notify_all();
+        }
+        if (batch.size() >= max_size || shutdown_ || std::chrono::steady_clock::now() >= linger_until) return;
+        if (!queue_.empty() && pop_waiting_ == 0) return; // lingering would stall other queued work
+        ++batch_waiting_;
+        batch_cv_.wait_until(lock, linger_until);
+        --batch_waiting_;
+    }
+}
+
+void JobQueue::set_shedding(SheddingOptions options) {
+    auto lock = acquire();
+    shedding_ = options;
+    first_above_ = {};
+    dropping_ = false;
+    sheddable_enqueued_.clear();
+    for (const Job& job : queue_) track_sheddable(job);
+}
+
+bool JobQueue::shedding() {
+    auto lock = acquire();
+    return dropping_;
+}
+
+QueueContentionStats JobQueue::contention() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::unique_lock<std::mutex> JobQueue::acquire() {
+#ifdef JOBQUEUE_CONTENTION_STATS
+    std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        const uint64_t start = contention::now_ns();
+        lock.lock();
+        stats_.lock_wait_ns += contention::now_ns() - start;
+        ++stats_.lock_contended;
+    }
+    ++stats_.lock_acquisitions;
+    return lock;
+#else
+    return std::unique_lock<std::mutex>(mutex_);
+#endif
+}
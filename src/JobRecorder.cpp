@@ -0,0 +1,165 @@
+#include "JobRecorder.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+constexpr char kMagic[] = "JQREC1\n";
+constexpr size_t kMagicBytes = sizeof(kMagic) - 1;
+
+uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+int64_t to_ns(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+class Reader {
+public:
+    explicit Reader(const std::vector<char>& data) : data_(data) {}
+
+    bool done() const { return pos_ >= data_.size(); }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos_ >= data_.size()) throw std::runtime_error("Truncated job recording");
+            const auto byte = static_cast<uint8_t>(data_[pos_++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return value;
+        }
+        throw std::runtime_error("Malformed varint in job recording");
+    }
+
+    std::string bytes(size_t n) {
+        if (data_.size() - pos_ < n) throw std::runtime_error("Truncated job recording");
+        std::string out(data_.data() + pos_, n);
+        pos_ += n;
+        return out;
+    }
+
+private:
+    const std::vector<char>& data_;
+    size_t pos_ = kMagicBytes;
+};
+}
+
+JobRecorder& JobRecorder::instance() {
+    // Leaked on purpose: workers may still record during static destruction.
+    static JobRecorder* recorder = new JobRecorder();
+    return *recorder;
+}
+
+void JobRecorder::start(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_ != nullptr) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) {
+        throw std::runtime_error("Cannot write job recording: " + path);
+    }
+    std::fwrite(kMagic, 1, kMagicBytes, file_);
+    epoch_ = std::chrono::steady_clock::now();
+    last_submit_ns_ = 0;
+    names_.clear();
+    recorded_.store(0, std::memory_order_relaxed);
+    enabled_.store(true, std::memory_order_release);
+}
+
+void JobRecorder::stop() {
+    enabled_.store(false, std::memory_order_release);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_ != nullptr) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+void JobRecorder::put_varint(uint64_t value) {
+    uint8_t buf[10];
+    size_t n = 0;
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        buf[n++] = static_cast<uint8_t>(value != 0 ? byte | 0x80 : byte);
+    } while (value != 0);
+    std::fwrite(buf, 1, n, file_);
+}
+
+void JobRecorder::record(const JobMetadata& metadata, std::chrono::steady_clock::time_point started,
+                         int64_t run_ns, uint8_t flags) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_ == nullptr) return;
+
+    auto name = names_.find(metadata.name);
+    if (name == names_.end()) {
+        name = names_.emplace(metadata.name, names_.size()).first;
+        put_varint(0);
+        put_varint(name->second);
+        put_varint(metadata.name.size());
+        std::fwrite(metadata.name.data(), 1, metadata.name.size(), file_);
+    }
+
+    const int64_t submit_ns = to_ns(metadata.enqueue_time - epoch_);
+    put_varint(1);
+    put_varint(zigzag(submit_ns - last_submit_ns_));
+    put_varint(zigzag(metadata.priority));
+    put_varint(static_cast<uint64_t>(std::max<int64_t>(0, metadata.timeout.count())));
+    put_varint(name->second);
+    put_varint(static_cast<uint64_t>(std::max<int64_t>(0, to_ns(started - metadata.enqueue_time))));
+    put_varint(static_cast<uint64_t>(std::max<int64_t>(0, run_ns)));
+    put_varint(flags);
+    last_submit_ns_ = submit_ns;
+    recorded_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<JobRecorder::Record> JobRecorder::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot read job recording: " + path);
+    }
+    const std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < kMagicBytes || !std::equal(kMagic, kMagic + kMagicBytes, data.begin())) {
+        throw std::runtime_error("Not a job recording: " + path);
+    }
+
+    std::vector<std::string> names;
+    std::vector<Record> records;
+    Reader in(data);
+    int64_t submit_ns = 0;
+    while (!in.done()) {
+        const uint64_t type = in.varint();
+        if (type == 0) {
+            const uint64_t id = in.varint();
+            std::string name = in.bytes(in.varint());
+            if (id >= names.size()) names.resize(id + 1);
+            names[id] = std::move(name);
+        } else if (type == 1) {
+            Record r;
+            submit_ns += unzigzag(in.varint());
+            r.submit_ns = submit_ns;
+            r.priority = static_cast<int>(unzigzag(in.varint()));
+            r.timeout_ms = static_cast<int64_t>(in.varint());
+            const uint64_t name = in.varint();
+            if (name >= names.size()) throw std::runtime_error("Undefined job name in recording");
+            r.name = names[name];
+            r.wait_ns = static_cast<int64_t>(in.varint());
+            r.run_ns = static_cast<int64_t>(in.varint());
+            r.flags = static_cast<uint8_t>(in.varint());
+            records.push_back(std::move(r));
+        } else {
+            throw std::runtime_error("Unknown entry in job recording");
+        }
+    }
+    std::stable_sort(records.begin(), records.end(),
+                     [](const Record& a, const Record& b) { return a.submit_ns < b.submit_ns; });
+    return records;
+}
@@ -0,0 +1,245 @@
+#include "JobTracer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+const char* phase_name(JobTracer::Phase phase) {
+    switch (phase) {
+    case JobTracer::Phase::Submit:  return "submit";
+    case JobTracer::Phase::Enqueue: return "enqueue";
+    case JobTracer::Phase::Pop:     return "pop";
+    case JobTracer::Phase::Start:   return "start";
+    case JobTracer::Phase::Finish:  return "finish";
+    case JobTracer::Phase::Fail:    return "fail";
+    case JobTracer::Phase::Retry:   return "retry";
+    case JobTracer::Phase::Expire:  return "expire";
+    case JobTracer::Phase::Cancel:  return "cancel";
+    case JobTracer::Phase::Abort:   return "abort";
+    }
+    return "unknown";
+}
+
+void append_escaped(std::string& out, const char* text) {
+    for (const char* p = text; *p != '\0'; ++p) {
+        const unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+}
+}
+
+// Single-producer ring. Each slot carries a sequence number (index + 1 once written, 0
+// while being written) so dump() can copy slots concurrently and discard torn ones.
+struct JobTracer::Ring {
+    Ring(size_t capacity, uint32_t tid_)
+        : events(new Event[capacity]), seq(new std::atomic<uint64_t>[capacity]), mask(capacity - 1), tid(tid_) {
+        for (size_t i = 0; i < capacity; ++i) {
+            seq[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void push(const Event& event) {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        auto& slot_seq = seq[h & mask];
+        slot_seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        events[h & mask] = event;
+        slot_seq.store(h + 1, std::memory_order_release);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    void copy_to(std::vector<Event>& out) const {
+        const uint64_t h = head.load(std::memory_order_acquire);
+        const uint64_t first = h > mask + 1 ? h - (mask + 1) : 0;
+        for (uint64_t i = first; i < h; ++i) {
+            const auto& slot_seq = seq[i & mask];
+            if (slot_seq.load(std::memory_order_acquire) != i + 1) continue;
+            Event copy = events[i & mask];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot_seq.load(std::memory_order_relaxed) != i + 1) continue;
+            out.push_back(copy);
+        }
+    }
+
+    std::unique_ptr<Event[]> events;
+    std::unique_ptr<std::atomic<uint64_t>[]> seq;
+    uint64_t mask;
+    uint32_t tid;
+    std::atomic<uint64_t> head{0};
+};
+
+JobTracer& JobTracer::instance() {
+    // Leaked on purpose: worker threads may still record during static destruction.
+    static JobTracer* tracer = new JobTracer();
+    return *tracer;
+}
+
+void JobTracer::enable(const std::string& output_path, size_t events_per_thread) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t capacity = 1;
+    while (capacity < std::max<size_t>(events_per_thread, 2)) capacity <<= 1;
+    capacity_ = capacity;
+    output_path_ = output_path;
+    if (epoch_ns_ == 0) {
+        epoch_ns_ = now_ns();
+    }
+    enabled_.store(true, std::memory_order_release);
+}
+
+void JobTracer::disable() {
+    enabled_.store(false, std::memory_order_release);
+}
+
+JobTracer::Ring* JobTracer::local_ring() {
+    // Threads beyond kMaxThreads are refused once and then drop their events.
+    thread_local Ring* ring = nullptr;
+    thread_local bool refused = false;
+    if (ring != nullptr || refused) return ring;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (rings_.size() >= kMaxThreads) {
+        refused = true;
+        return nullptr;
+    }
+    rings_.push_back(std::make_unique<Ring>(capacity_, static_cast<uint32_t>(rings_.size() + 1)));
+    ring = rings_.back().get();
+    return ring;
+}
+
+void JobTracer::record_slow(Phase phase, const JobMetadata& metadata) {
+    Ring* ring = local_ring();
+    if (ring == nullptr) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Event event;
+    event.ts_ns = now_ns();
+    event.trace_id = metadata.trace_id;
+    event.job_id = metadata.id;
+    event.priority = metadata.priority;
+    event.attempt = static_cast<uint16_t>(std::min(metadata.current_retry, 0xffff));
+    event.phase = phase;
+    const size_t length = std::min(metadata.name.size(), kNameBytes - 1);
+    std::memcpy(event.name, metadata.name.data(), length);
+    event.name[length] = '\0';
+    ring->push(event);
+}
+
+void JobTracer::dump(const std::string& path) {
+    std::vector<std::pair<uint32_t, std::vector<Event>>> per_thread;
+    uint64_t epoch = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        epoch = epoch_ns_;
+        for (const auto& ring : rings_) {
+            per_thread.emplace_back(ring->tid, std::vector<Event>());
+            ring->copy_to(per_thread.back().second);
+        }
+    }
+
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    char buf[160];
+    auto begin_event = [&](const char* ph, const char* name, uint32_t tid, uint64_t ts_ns) {
+        out += first ? "" : ",\n";
+        first = false;
+        out += "{\"ph\":\"";
+        out += ph;
+        out += "\",\"name\":\"";
+        append_escaped(out, name);
+        std::snprintf(buf, sizeof(buf), "\",\"pid\":1,\"tid\":%u,\"ts\":%.3f", tid,
+                      static_cast<double>(ts_ns - std::min(ts_ns, epoch)) / 1000.0);
+        out += buf;
+    };
+    auto job_args = [&](const Event& e) {
+        std::snprintf(buf, sizeof(buf), ",\"args\":{\"job_id\":%d,\"trace_id\":%llu,\"priority\":%d,\"attempt\":%u,\"job\":\"",
+                      e.job_id, static_cast<unsigned long long>(e.trace_id), e.priority,
+                      static_cast<unsigned>(e.attempt));
+        out += buf;
+        append_escaped(out, e.name);
+        out += "\"}}";
+    };
+    auto async_edge = [&](const char* ph, const Event& e, uint32_t tid) {
+        begin_event(ph, e.name, tid, e.ts_ns);
+        std::snprintf(buf, sizeof(buf), ",\"cat\":\"job\",\"id\":%llu}", static_cast<unsigned long long>(e.trace_id));
+        out += buf;
+    };
+
+    for (const auto& [tid, events] : per_thread) {
+        std::snprintf(buf, sizeof(buf), "thread %u", tid);
+        out += first ? "" : ",\n";
+        first = false;
+        out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" + std::to_string(tid) +
+               ",\"args\":{\"name\":\"" + buf + "\"}}";
+
+        for (const Event& e : events) {
+            switch (e.phase) {
+            case Phase::Start:
+                // Duration slice on the worker for this attempt.
+                begin_event("B", e.name, tid, e.ts_ns);
+                job_args(e);
+                continue;
+            case Phase::Finish:
+            case Phase::Fail:
+            case Phase::Retry:
+                begin_event("E", e.name, tid, e.ts_ns);
+                out += "}";
+                break;
+            default:
+                break;
+            }
+
+            begin_event("i", phase_name(e.phase), tid, e.ts_ns);
+            out += ",\"s\":\"t\"";
+            job_args(e);
+
+            // Async track spanning submit to the terminal outcome, across threads.
+            if (e.phase == Phase::Submit) {
+                async_edge("b", e, tid);
+            } else if (e.phase != Phase::Enqueue && e.phase != Phase::Pop && e.phase != Phase::Retry) {
+                async_edge("e", e, tid);
+            }
+        }
+    }
+    out += "\n]}\n";
+
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+            throw std::runtime_error("Cannot write trace: " + tmp_path);
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Cannot write trace: " + path);
+    }
+}
+
+void JobTracer::dump_if_configured() {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        path = output_path_;
+    }
+    if (!path.empty()) {
+        dump(path);
+    }
+}
@@ -1,10 +1,14 @@
 #include "Metrics.hpp"
 #include "MetricsServer.hpp"
+#include "JobProfiler.hpp"
 #include <cstdlib>
 #include <filesystem>
-#include <prometheus/counter.h>
-#include <prometheus/gauge.h>
-#include <prometheus/registry.h>
+#include <limits>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include <prometheus/client_metric.h>
+#include <prometheus/collectable.h>
+#include <prometheus/metric_family.h>
 
 using namespace prometheus;
 
@@ -20,6 +24,229 @@ std::string metrics_bind_address() {
 
     return "127.0.0.1:8080";
 }
+
+void add_histogram(ClientMetric& metric, const ShardedHistogram::Snapshot& snap) {
+    metric.histogram.sample_count = snap.count;
+    metric.histogram.sample_sum = snap.sum;
+    for (size_t i = 0; i < snap.cumulative_counts.size(); ++i) {
+        ClientMetric::Bucket bucket;
+        bucket.cumulative_count = snap.cumulative_counts[i];
+        bucket.upper_bound = i < snap.upper_bounds.size() ? snap.upper_bounds[i]
+                                                          : std::numeric_limits<double>::infinity();
+        metric.histogram.bucket.push_back(bucket);
+    }
+}
+
+MetricFamily counter_family(const std::string& name, const std::string& help, const ShardedCounter& counter) {
+    ClientMetric metric;
+    metric.counter.value = counter.Value();
+    return MetricFamily{name, help, MetricType::Counter, {metric}};
+}
+
+MetricFamily gauge_family(const std::string& name, const std::string& help, const ShardedGauge& gauge) {
+    ClientMetric metric;
+    metric.gauge.value = gauge.Value();
+    return MetricFamily{name, help, MetricType::Gauge, {metric}};
+}
+
+MetricFamily histogram_family(const std::string& name, const std::string& help, const ShardedHistogram& histogram) {
+    ClientMetric metric;
+    add_histogram(metric, histogram.snapshot());
+    return MetricFamily{name, help, MetricType::Histogram, {metric}};
+}
+
+// One labelled metric per (job, priority) series that has seen at least one sample.
+MetricFamily timing_family(const std::string& name, const std::string& help, const JobLatencyMetrics& timing,
+                           ShardedLogHistogram JobLatencyMetrics::Series::*histogram) {
+    MetricFamily family{name, help, MetricType::Histogram, {}};
+    for (size_t i = 0; i < timing.size(); ++i) {
+        const auto& series = timing.series(i);
+        const auto snap = (series.*histogram).snapshot();
+        if (snap.count == 0) continue;
+        ClientMetric metric;
+        metric.label = {ClientMetric::Label{"job", series.job},
+                        ClientMetric::Label{"priority", series.priority_label}};
+        add_histogram(metric, snap);
+        family.metric.push_back(std::move(metric));
+    }
+    return family;
+}
+
+ClientMetric labelled(double value, MetricType type, std::vector<ClientMetric::Label> labels) {
+    ClientMetric metric;
+    metric.label = std::move(labels);
+    if (type == MetricType::Counter) {
+        metric.counter.value = value;
+    } else {
+        metric.gauge.value = value;
+    }
+    return metric;
+}
+
+// Queue and worker contention for every registered pool, labelled by registration order.
+void append_contention(std::vector<MetricFamily>& families, const std::vector<PoolContentionStats>& pools) {
+    if (!contention::kEnabled) return;
+
+    struct QueueField {
+        const char* name;
+        const char* help;
+        uint64_t QueueContentionStats::*field;
+        double scale;
+    };
+    static const QueueField queue_fields[] = {
+        {"job_queue_lock_acquisitions_total", "JobQueue mutex acquisitions", &QueueContentionStats::lock_acquisitions, 1.0},
+        {"job_queue_lock_contended_total", "JobQueue mutex acquisitions that had to block", &QueueContentionStats::lock_contended, 1.0},
+        {"job_queue_lock_wait_seconds_total", "Time spent blocked acquiring the JobQueue mutex", &QueueContentionStats::lock_wait_ns, 1e-9},
+        {"job_queue_producer_waits_total", "Pushes that blocked on a full queue", &QueueContentionStats::producer_waits, 1.0},
+        {"job_queue_producer_block_seconds_total", "Time producers spent blocked on a full queue", &QueueContentionStats::producer_block_ns, 1e-9},
+        {"job_queue_consumer_waits_total", "Pops that parked on an empty queue", &QueueContentionStats::consumer_waits, 1.0},
+        {"job_queue_consumer_park_seconds_total", "Time workers spent parked on an empty queue", &QueueContentionStats::consumer_park_ns, 1e-9},
+        {"job_queue_spurious_wakeups_total", "Condition variable wakeups that found nothing to do", &QueueContentionStats::spurious_wakeups, 1.0},
+    };
+    for (const auto& f : queue_fields) {
+        MetricFamily family{f.name, f.help, MetricType::Counter, {}};
+        for (size_t p = 0; p < pools.size(); ++p) {
+            family.metric.push_back(labelled(static_cast<double>(pools[p].queue.*f.field) * f.scale, MetricType::Counter,
+                                             {ClientMetric::Label{"pool", std::to_string(p)}}));
+        }
+        families.push_back(std::move(family));
+    }
+
+    MetricFamily busy{"worker_busy_seconds_total", "Time each worker spent outside JobQueue::pop", MetricType::Counter, {}};
+    MetricFamily idle{"worker_idle_seconds_total", "Time each worker spent inside JobQueue::pop", MetricType::Counter, {}};
+    MetricFamily ratio{"worker_busy_ratio", "Busy share of each worker's lifetime", MetricType::Gauge, {}};
+    for (size_t p = 0; p < pools.size(); ++p) {
+        for (size_t w = 0; w < pools[p].workers.size(); ++w) {
+            const auto& worker = pools[p].workers[w];
+            std::vector<ClientMetric::Label> labels = {ClientMetric::Label{"pool", std::to_string(p)},
+                                                       ClientMetric::Label{"worker", std::to_string(w)}};
+            busy.metric.push_back(labelled(static_cast<double>(worker.busy_ns) * 1e-9, MetricType::Counter, labels));
+            idle.metric.push_back(labelled(static_cast<double>(worker.idle_ns) * 1e-9, MetricType::Counter, labels));
+            ratio.metric.push_back(labelled(worker.busy_ratio(), MetricType::Gauge, labels));
+        }
+    }
+    families.push_back(std::move(busy));
+    families.push_back(std::move(idle));
+    families.push_back(std::move(ratio));
+}
+
+// Stuck and blocked worker state for every pool with a watchdog or blocking workers,
+// labelled by registration order.
+void append_watchdog(std::vector<MetricFamily>& families, const std::vector<WatchdogStats>& pools) {
+    if (pools.empty()) return;
+
+    MetricFamily stuck{"stuck_workers", "Workers running one job for longer than the stuck threshold", MetricType::Gauge, {}};
+    MetricFamily longest{"longest_running_job_seconds", "Age of the oldest job currently running", MetricType::Gauge, {}};
+    MetricFamily compensating{"compensating_workers", "Extra workers started to cover stuck or blocked ones", MetricType::Gauge, {}};
+    MetricFamily blocked{"blocked_workers", "Workers inside a declared blocking section", MetricType::Gauge, {}};
+    MetricFamily flagged{"stuck_jobs_total", "Jobs flagged as stuck by the watchdog", MetricType::Counter, {}};
+    for (size_t p = 0; p < pools.size(); ++p) {
+        std::vector<ClientMetric::Label> labels = {ClientMetric::Label{"pool", std::to_string(p)}};
+        stuck.metric.push_back(labelled(static_cast<double>(pools[p].stuck_workers), MetricType::Gauge, labels));
+        longest.metric.push_back(labelled(pools[p].longest_running_seconds, MetricType::Gauge, labels));
+        compensating.metric.push_back(labelled(static_cast<double>(pools[p].compensating_workers), MetricType::Gauge, labels));
+        blocked.metric.push_back(labelled(static_cast<double>(pools[p].blocked_workers), MetricType::Gauge, labels));
+        flagged.metric.push_back(labelled(static_cast<double>(pools[p].stuck_jobs_total), MetricType::Counter, labels));
+    }
+    families.push_back(std::move(stuck));
+    families.push_back(std::move(longest));
+    families.push_back(std::move(compensating));
+    families.push_back(std::move(blocked));
+    families.push_back(std::move(flagged));
+}
+
+void append_lanes(std::vector<MetricFamily>& families, const std::vector<LaneStats>& pools) {
+    if (pools.empty()) return;
+
+    MetricFamily utilization{"lane_utilization", "Share of time lane or shared workers spent running jobs", MetricType::Gauge, {}};
+    MetricFamily wait{"lane_mean_queue_wait_seconds", "Mean queue wait of jobs in the lane or shared class", MetricType::Gauge, {}};
+    MetricFamily borrowed{"lane_borrowed_jobs_total", "Jobs above the lane priority run by lane workers", MetricType::Counter, {}};
+    for (size_t p = 0; p < pools.size(); ++p) {
+        const std::pair<const char*, const LaneClassStats*> classes[] = {{"reserved", &pools[p].reserved},
+                                                                          {"shared", &pools[p].shared}};
+        for (const auto& c : classes) {
+            std::vector<ClientMetric::Label> labels = {ClientMetric::Label{"pool", std::to_string(p)},
+                                                       ClientMetric::Label{"lane", c.first}};
+            utilization.metric.push_back(labelled(c.second->utilization, MetricType::Gauge, labels));
+            wait.metric.push_back(labelled(c.second->mean_wait_seconds, MetricType::Gauge, labels));
+        }
+        borrowed.metric.push_back(labelled(static_cast<double>(pools[p].reserved.borrowed), MetricType::Counter,
+                                           {ClientMetric::Label{"pool", std::to_string(p)}}));
+    }
+    families.push_back(std::move(utilization));
+    families.push_back(std::move(wait));
+    families.push_back(std::move(borrowed));
+}
+
+// Per-job-name CPU cost from JobProfiler (empty unless profiling is enabled).
+void append_profile(std::vector<MetricFamily>& families) {
+    const auto profiles = JobProfiler::instance().profile();
+    if (profiles.empty()) return;
+
+    MetricFamily cpu{"job_cpu_seconds", "Thread CPU time per job attempt", MetricType::Histogram, {}};
+    MetricFamily wall{"job_profiled_wall_seconds_total", "Wall time of profiled job attempts", MetricType::Counter, {}};
+    MetricFamily switches{"job_context_switches_total", "Context switches during job attempts", MetricType::Counter, {}};
+    for (const auto& p : profiles) {
+        ClientMetric metric;
+        metric.label = {ClientMetric::Label{"job", p.job}};
+        add_histogram(metric, p.cpu);
+        cpu.metric.push_back(std::move(metric));
+        wall.metric.push_back(labelled(p.wall_seconds, MetricType::Counter, {ClientMetric::Label{"job", p.job}}));
+        if (JobProfiler::instance().context_switches()) {
+            switches.metric.push_back(labelled(static_cast<double>(p.voluntary_switches), MetricType::Counter,
+                                               {ClientMetric::Label{"job", p.job}, ClientMetric::Label{"kind", "voluntary"}}));
+            switches.metric.push_back(labelled(static_cast<double>(p.involuntary_switches), MetricType::Counter,
+                                               {ClientMetric::Label{"job", p.job}, ClientMetric::Label{"kind", "involuntary"}}));
+        }
+    }
+    families.push_back(std::move(cpu));
+    families.push_back(std::move(wall));
+    if (!switches.metric.empty()) {
+        families.push_back(std::move(switches));
+    }
+}
+
+// Sums the per-thread shards into Prometheus families at scrape time.
+class ShardedCollector : public Collectable {
+public:
+    explicit ShardedCollector(Metrics& metrics) : metrics_(metrics) {}
+
+    std::vector<MetricFamily> Collect() const override {
+        std::vector<MetricFamily> families = {
+            counter_family("jobs_submitted_total", "Total number of jobs submitted", metrics_.job_submitted()),
+            counter_family("jobs_completed_total", "Total number of jobs completed", metrics_.job_completed()),
+            counter_family("jobs_failed_total", "Total number of jobs failed", metrics_.job_failed()),
+            counter_family("jobs_rejected_total", "Submissions refused because the queue was full",
+                           metrics_.job_rejected()),
+            counter_family("jobs_dropped_total", "Queued jobs evicted by the overflow policy",
+                           metrics_.job_dropped()),
+            counter_family("jobs_coalesced_total", "Submissions merged into a queued job with the same key",
+                           metrics_.job_coalesced()),
+            counter_family("job_batches_total", "Batch handler calls; batched jobs count in jobs_completed_total",
+                           metrics_.job_batches()),
+            counter_family("strand_jobs_deferred_total", "Keyed jobs held back until the previous job for the key ended",
+                           metrics_.strand_deferred()),
+            counter_family("strand_handoffs_total", "Keyed jobs run next by the worker that ran the previous one",
+                           metrics_.strand_handoff()),
+            gauge_family("active_jobs", "Current number of active jobs", metrics_.active_jobs()),
+            histogram_family("job_latency_seconds", "Job execution latency in seconds", metrics_.job_latency()),
+            timing_family("job_queue_wait_seconds", "Time from submission to first execution start",
+                          metrics_.job_timing(), &JobLatencyMetrics::Series::queue_wait),
+            timing_family("job_execution_seconds", "Execution time of each attempt, including failed ones",
+                          metrics_.job_timing(), &JobLatencyMetrics::Series::execution),
+            timing_family("job_end_to_end_seconds", "Time from submission to successful completion",
+                          metrics_.job_timing(), &JobLatencyMetrics::Series::end_to_end),
+        };
+        append_contention(families, metrics_.contention_stats());
+        append_watchdog(families, metrics_.watchdog_stats());
+        append_lanes(families, metrics_.lane_stats());
+        append_profile(families);
+        return families;
+    }
+
+private:
+    Metrics& metrics_;
+};
 }
 
 void Metrics::init(const std::string& endpoint) {
@@ -27,39 +254,8 @@ void Metrics::init(const std::string& endpoint) {
     spdlog::info("Metrics initialized at endpoint: {}", endpoint_);
     MetricsServer::instance().start(metrics_bind_address());
 
-    registry_ = MetricsServer::instance().getRegistry();
-
-    auto& counter_family = BuildCounter()
-        .Name("jobs_submitted_total")
-        .Help("Total number of jobs submitted")
-        .Register(*registry_);
-    job_submitted_ = &counter_family.Add({});
-
-    auto& completed_family = BuildCounter()
-        .Name("jobs_completed_total")
-        .Help("Total number of jobs completed")
-        .Register(*registry_);
-    job_completed_ = &completed_family.Add({});
-
-    auto& failed_family = BuildCounter()
-        .Name("jobs_failed_total")
-        .Help("Total number of jobs failed")
-        .Register(*registry_);
-    job_failed_ = &failed_family.Add({});
-
-    auto& gauge_family = BuildGauge()
-        .Name("active_jobs")
-        .Help("Current number of active jobs")
-        .Register(*registry_);
-    active_jobs_ = &gauge_family.Add({});
-
-    auto& latency_family = BuildHistogram()
-        .Name("job_latency_seconds")
-        .Help("Job execution latency in seconds")
-        .Register(*registry_);
-    job_latency_ = &latency_family.Add({}, Histogram::BucketBoundaries{0.01, 0.05, 0.1, 0.3, 0.5, 1.0, 2.0});
-}
-
-Histogram& Metrics::job_latency() {
-    return *job_latency_;
+    if (!collector_) {
+        collector_ = std::make_shared<ShardedCollector>(*this);
+        MetricsServer::instance().registerCollectable(collector_);
+    }
 }
@@ -15,3 +15,9 @@ void MetricsServer::start(const std::string& address) {
 std::shared_ptr<prometheus::Registry> MetricsServer::getRegistry() {
     return registry_;
 }
+
+void MetricsServer::registerCollectable(const std::shared_ptr<prometheus::Collectable>& collectable) {
+    if (!exposer_) return;
+    collectables_.push_back(collectable); // the exposer only holds a weak_ptr
+    exposer_->RegisterCollectable(collectable);
+}
@@ -0,0 +1,183 @@
+#include "ShardedMetrics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace metrics_shard {
+
+namespace {
+constexpr double kSumScale = 1e9;
+
+// Registers the calling thread's slab on first use and folds it into the retired
+// totals when the thread exits, so counts from short-lived producers are not lost.
+struct SlabHandle {
+    Slab slab;
+    SlabHandle() { Registry::instance().attach(&slab); }
+    ~SlabHandle() { Registry::instance().detach(&slab); }
+};
+}
+
+Chunk::Chunk() {
+    for (auto& cell : cells) {
+        cell.store(0, std::memory_order_relaxed);
+    }
+}
+
+Slab::Slab() {
+    for (auto& chunk : chunks) {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+Slab::~Slab() {
+    for (auto& chunk : chunks) {
+        delete chunk.load(std::memory_order_relaxed);
+    }
+}
+
+Chunk* Slab::grow(size_t chunk_index) {
+    if (chunk_index >= kMaxChunks) {
+        throw std::length_error("Sharded metric cell out of range");
+    }
+    // Only the owning thread grows its slab; release pairs with the scraper's acquire load.
+    Chunk* chunk = new Chunk();
+    chunks[chunk_index].store(chunk, std::memory_order_release);
+    return chunk;
+}
+
+Registry& Registry::instance() {
+    // Leaked on purpose: thread-local slabs may detach after static destruction starts.
+    static Registry* registry = new Registry();
+    return *registry;
+}
+
+size_t Registry::allocate(size_t count) {
+    const size_t first = next_cell_.fetch_add(count, std::memory_order_relaxed);
+    if (first + count > kChunkCells * kMaxChunks) {
+        throw std::length_error("Sharded metric cells exhausted");
+    }
+    return first;
+}
+
+void Registry::sum(size_t first, size_t count, std::vector<int64_t>& out) {
+    out.assign(count, 0);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto accumulate = [&](const Slab& slab) {
+        for (size_t i = 0; i < count; ++i) {
+            const size_t cell = first + i;
+            const Chunk* chunk = slab.chunks[cell / kChunkCells].load(std::memory_order_acquire);
+            if (chunk != nullptr) {
+                out[i] += chunk->cells[cell % kChunkCells].load(std::memory_order_relaxed);
+            }
+        }
+    };
+    accumulate(retired_);
+    for (const Slab* slab : live_) {
+        accumulate(*slab);
+    }
+}
+
+int64_t Registry::sum(size_t cell) {
+    std::vector<int64_t> out;
+    sum(cell, 1, out);
+    return out[0];
+}
+
+void Registry::attach(Slab* slab) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    live_.push_back(slab);
+}
+
+void Registry::detach(Slab* slab) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    live_.erase(std::remove(live_.begin(), live_.end(), slab), live_.end());
+    for (size_t c = 0; c < kMaxChunks; ++c) {
+        const Chunk* chunk = slab->chunks[c].load(std::memory_order_acquire);
+        if (chunk == nullptr) continue;
+        Chunk* target = retired_.chunks[c].load(std::memory_order_relaxed);
+        if (target == nullptr) {
+            target = retired_.grow(c);
+        }
+        for (size_t i = 0; i < kChunkCells; ++i) {
+            target->cells[i].fetch_add(chunk->cells[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+}
+
+Slab& local_slab() {
+    thread_local SlabHandle handle;
+    return handle.slab;
+}
+
+} // namespace metrics_shard
+
+ShardedHistogram::ShardedHistogram(std::vector<double> upper_bounds)
+    : bounds_(std::move(upper_bounds)) {
+    std::sort(bounds_.begin(), bounds_.end());
+    first_cell_ = metrics_shard::Registry::instance().allocate(bounds_.size() + 2);
+}
+
+void ShardedHistogram::Observe(double value) {
+    const size_t bucket = static_cast<size_t>(
+        std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin());
+    metrics_shard::add(first_cell_ + bucket, 1);
+    metrics_shard::add(first_cell_ + bounds_.size() + 1,
+                       static_cast<int64_t>(std::llround(value * metrics_shard::kSumScale)));
+}
+
+ShardedHistogram::Snapshot ShardedHistogram::snapshot() const {
+    std::vector<int64_t> cells;
+    metrics_shard::Registry::instance().sum(first_cell_, bounds_.size() + 2, cells);
+
+    Snapshot snap;
+    snap.upper_bounds = bounds_;
+    snap.cumulative_counts.resize(bounds_.size() + 1);
+    uint64_t running = 0;
+    for (size_t i = 0; i <= bounds_.size(); ++i) {
+        running += static_cast<uint64_t>(cells[i]);
+        snap.cumulative_counts[i] = running;
+    }
+    snap.count = running;
+    snap.sum = static_cast<double>(cells[bounds_.size() + 1]) / metrics_shard::kSumScale;
+    return snap;
+}
+
+ShardedLogHistogram::ShardedLogHistogram()
+    : first_cell_(metrics_shard::Registry::instance().allocate(kFiniteBuckets + 2)) {}
+
+void ShardedLogHistogram::Observe(double seconds) {
+    ObserveNanos(static_cast<int64_t>(std::llround(seconds * metrics_shard::kSumScale)));
+}
+
+const std::vector<double>& ShardedLogHistogram::upper_bounds() {
+    static const std::vector<double> bounds = [] {
+        std::vector<double> out;
+        out.reserve(kFiniteBuckets);
+        out.push_back(static_cast<double>(int64_t(1) << kMinExponent) / metrics_shard::kSumScale);
+        for (int exponent = kMinExponent; exponent < kMaxExponent; ++exponent) {
+            for (int64_t sub = 0; sub < kSubBuckets; ++sub) {
+                const int64_t upper = (kSubBuckets + sub + 1) << (exponent - kSubBucketBits);
+                out.push_back(static_cast<double>(upper) / metrics_shard::kSumScale);
+            }
+        }
+        return out;
+    }();
+    return bounds;
+}
+
+ShardedHistogram::Snapshot ShardedLogHistogram::snapshot() const {
+    std::vector<int64_t> cells;
+    metrics_shard::Registry::instance().sum(first_cell_, kFiniteBuckets + 2, cells);
+
+    ShardedHistogram::Snapshot snap;
+    snap.upper_bounds = upper_bounds();
+    snap.cumulative_counts.resize(kFiniteBuckets + 1);
+    uint64_t running = 0;
+    for (size_t i = 0; i <= kFiniteBuckets; ++i) {
+        running += static_cast<uint64_t>(cells[i]);
+        snap.cumulative_counts[i] = running;
+    }
+    snap.count = running;
+    snap.sum = static_cast<double>(cells[kFiniteBuckets + 1]) / metrics_shard::kSumScale;
+    return snap;
+}
@@ -3,10 +3,15 @@
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <optional>
 #include <random>
 #include <spdlog/spdlog.h>
+#include "JobLog.hpp"
 #include <thread>
 #include "formatters/thread_id_formatter.hpp"
+#include "JobProfiler.hpp"
+#include "JobRecorder.hpp"
+#include "JobTracer.hpp"
 
 namespace {
 std::exception_ptr make_runtime_exception_ptr(const char* message) {
@@ -29,7 +34,7 @@ std::chrono::milliseconds compute_retry_delay(const JobMetadata& metadata) {
     }
 
     if (metadata.retry_max_backoff.count() > 0) {
-        delay_ms = std::min(delay_ms, metadata.retry_max_backoff.count());
+        delay_ms = std::min<long long>(delay_ms, metadata.retry_max_backoff.count());
     }
 
     if (metadata.retry_jitter_factor > 0.0) {
@@ -42,33 +47,312 @@ std::chrono::milliseconds compute_retry_delay(const JobMetadata& metadata) {
 
     return std::chrono::milliseconds(std::max<long long>(0, delay_ms));
 }
+
+// Single writer per worker slot, so plain load + store instead of fetch_add.
+void bump(std::atomic<uint64_t>& field, uint64_t delta) {
+    field.store(field.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+// Publishes the running job to the watchdog for the duration of job.task(), exceptions included.
+class RunningJobMark {
+public:
+    RunningJobMark(std::atomic<uint64_t>* started_ns, std::atomic<int>& job_id, int id) : started_ns_(started_ns) {
+        if (started_ns_ == nullptr) return;
+        job_id.store(id, std::memory_order_relaxed);
+        started_ns_->store(contention::now_ns(), std::memory_order_release);
+    }
+    ~RunningJobMark() {
+        if (started_ns_ != nullptr) started_ns_->store(0, std::memory_order_release);
+    }
+    RunningJobMark(const RunningJobMark&) = delete;
+    RunningJobMark& operator=(const RunningJobMark&) = delete;
+
+private:
+    std::atomic<uint64_t>* started_ns_;
+};
+
+// A worker's slot for the next job of a strand it just ended, so that job runs on the same
+// thread without a queue round trip. Reserved lane workers take only jobs in their lane.
+struct StrandHandoff {
+    const ThreadPool* pool = nullptr;
+    int max_priority = std::numeric_limits<int>::max();
+    std::optional<JobQueue::Job> next;
+};
+thread_local StrandHandoff* current_handoff = nullptr;
 }
 
-ThreadPool::ThreadPool(size_t num_threads, size_t max_queue_size): job_queue_(max_queue_size), running_(true) {
+ThreadPool::ThreadPool(size_t num_threads, size_t max_queue_size, WatchdogOptions watchdog, LaneOptions lanes)
+    : job_queue_(max_queue_size), running_(true), lane_options_(lanes), lanes_enabled_(lanes.reserved_workers > 0),
+      watchdog_options_(watchdog), watchdog_enabled_(watchdog.stuck_threshold.count() > 0),
+      base_workers_(num_threads) {
+    if (lanes_enabled_) {
+        if (lanes.reserved_workers >= num_threads) {
+            throw std::runtime_error("ThreadPool: reserved_workers must be below num_threads");
+        }
+        job_queue_.configure_lane(lanes.max_priority, lanes.min_idle_reserved);
+        lanes_since_ns_ = contention::now_ns();
+    }
+    slot_count_ = num_threads + (watchdog_enabled_ ? watchdog.max_compensating_workers : 0) +
+                  watchdog.max_blocking_workers;
+    worker_stats_.reset(new WorkerSlot[slot_count_]);
+    compensating_threads_.resize(slot_count_ - num_threads);
     for (size_t i = 0; i < num_threads; ++i) {
-        workers_.emplace_back(&ThreadPool::worker_loop, this);
+        worker_stats_[i].live.store(true, std::memory_order_relaxed);
+        workers_.emplace_back(&ThreadPool::worker_loop, this, i);
         // constructs a new std::thread in place and adds it to the vector.
     }
+    if (contention::kEnabled) {
+        contention_source_ = Metrics::instance().add_contention_source([this]() { return contention_stats(); });
+    }
+    if (watchdog_enabled_) {
+        watchdog_ = std::thread(&ThreadPool::watchdog_loop, this);
+    }
+    if (watchdog_enabled_ || watchdog.max_blocking_workers > 0) {
+        watchdog_source_ = Metrics::instance().add_watchdog_source([this]() { return watchdog_stats(); });
+    }
+    if (lanes_enabled_) {
+        lane_source_ = Metrics::instance().add_lane_source([this]() { return lane_stats(); });
+    }
 }
 
 ThreadPool::~ThreadPool() {
     if (running_) {
         shutdown();
     }
+    if (contention_source_ >= 0) {
+        Metrics::instance().remove_contention_source(contention_source_);
+    }
+    if (watchdog_source_ >= 0) {
+        Metrics::instance().remove_watchdog_source(watchdog_source_);
+    }
+    if (lane_source_ >= 0) {
+        Metrics::instance().remove_lane_source(lane_source_);
+    }
 }
 
 void ThreadPool::submit(JobMetadata&& metadata, std::function<void()> task) {
     if (!running_) {
         throw std::runtime_error("Cannot submit job: ThreadPool is shut down");
     }
-    spdlog::info("Job submitted: ID = {}, Name = {}", metadata.id, metadata.name);
+    require_no_batching(metadata);
+    JOB_LOG_INFO("Job submitted: ID = {}, Name = {}", metadata.id, metadata.name);
+    enqueue(JobQueue::Job(std::move(metadata), std::move(task)));
+}
+
+void ThreadPool::submit(JobMetadata&& metadata, std::function<void()> task,
+                        std::function<void(std::exception_ptr)> on_failure) {
+    if (!running_) {
+        throw std::runtime_error("Cannot submit job: ThreadPool is shut down");
+    }
+    require_no_batching(metadata);
+    enqueue(JobQueue::Job(std::move(metadata), std::move(task), std::move(on_failure)));
+}
+
+SubmitStatus ThreadPool::try_submit(JobMetadata&& metadata, std::function<void()> task,
+                                    std::function<void(std::exception_ptr)> on_failure) {
+    require_no_batching(metadata);
+    JobQueue::Job job(std::move(metadata), std::move(task), std::move(on_failure));
+    return admit(job, std::chrono::steady_clock::now());
+}
+
+SubmitStatus ThreadPool::submit_for(JobMetadata&& metadata, std::chrono::milliseconds timeout,
+                                    std::function<void()> task, std::function<void(std::exception_ptr)> on_failure) {
+    require_no_batching(metadata);
+    JobQueue::Job job(std::move(metadata), std::move(task), std::move(on_failure));
+    return admit(job, std::chrono::steady_clock::now() + timeout);
+}
+
+SubmitStatus ThreadPool::enqueue(JobQueue::Job&& job) {
+    const auto deadline = overflow_policy_.load(std::memory_order_relaxed) == JobQueue::OverflowPolicy::Block
+                              ? std::chrono::steady_clock::time_point::max()
+                              : std::chrono::steady_clock::now();
+    switch (const auto status = try_enqueue(job, deadline)) {
+    case SubmitStatus::Accepted:
+    case SubmitStatus::Coalesced:
+        return status;
+    case SubmitStatus::Shutdown:
+        throw std::runtime_error("Cannot submit job: queue rejected enqueue during shutdown");
+    case SubmitStatus::Overloaded:
+        throw std::runtime_error("Cannot submit job: queue overloaded, shedding this priority");
+    default:
+        throw std::runtime_error("Cannot submit job: queue full");
+    }
+}
+
+// Status-returning submit: a job that is not accepted fails through its handler.
+SubmitStatus ThreadPool::admit(JobQueue::Job& job, std::chrono::steady_clock::time_point deadline) {
+    const auto status = running_ ? try_enqueue(job, deadline) : SubmitStatus::Shutdown;
+    switch (status) {
+    case SubmitStatus::Accepted:
+    case SubmitStatus::Coalesced:
+        break;
+    case SubmitStatus::Shutdown:
+        complete_terminal_failure(job, make_runtime_exception_ptr("Cannot submit job: ThreadPool is shut down"));
+        break;
+    case SubmitStatus::Timeout:
+        complete_terminal_failure(job, make_runtime_exception_ptr("Job rejected: queue still full after timeout"));
+        break;
+    case SubmitStatus::Rejected:
+        complete_terminal_failure(job, make_runtime_exception_ptr("Job rejected: queue full"));
+        break;
+    case SubmitStatus::Overloaded:
+        complete_terminal_failure(job, make_runtime_exception_ptr("Job rejected: queue overloaded"));
+        break;
+    }
+    return status;
+}
+
+SubmitStatus ThreadPool::try_enqueue(JobQueue::Job& job, std::chrono::steady_clock::time_point deadline) {
+    if (job.metadata.metrics_series < 0) {
+        job.metadata.metrics_series = Metrics::instance().job_series(job.metadata.name, job.metadata.priority);
+    }
+    const bool tracing = JobTracer::enabled();
+    if (tracing) {
+        job.metadata.trace_id = JobTracer::instance().next_trace_id();
+        JobTracer::instance().record(JobTracer::Phase::Submit, job.metadata);
+    }
+    // The job is moved into the queue, so keep what the Enqueue event needs.
+    JobMetadata traced;
+    if (tracing) {
+        traced.id = job.metadata.id;
+        traced.name = job.metadata.name;
+        traced.priority = job.metadata.priority;
+        traced.trace_id = job.metadata.trace_id;
+    }
     jobs_in_progress_++;
-    if (!job_queue_.push(JobQueue::Job(std::move(metadata), std::move(task)))) {
+    std::optional<JobQueue::Job> evicted;
+    const auto policy = overflow_policy_.load(std::memory_order_relaxed);
+    auto pushed = JobQueue::PushStatus::Ok;
+    bool opened = job.metadata.strand_key == 0;
+    bool reserved = false;
+    bool held = false;
+    // A job held in a strand keeps a reserved queue slot, so strands stay under
+    // max_queue_size and the overflow policy. Reserving may wait, so not under strands_mutex_.
+    while (!opened && !held) {
+        const auto entry = enter_strand(job, reserved);
+        if (entry == StrandEntry::Opened) {
+            opened = true;
+        } else if (entry == StrandEntry::Held) {
+            held = true;
+        } else {
+            pushed = job_queue_.reserve(job, deadline, policy, evicted);
+            if (pushed != JobQueue::PushStatus::Ok) break;
+            reserved = true;
+        }
+    }
+    if (opened && reserved) { // the key went idle while this job reserved its slot
+        pushed = job_queue_.requeue(job) ? JobQueue::PushStatus::Ok : JobQueue::PushStatus::Shutdown;
+    } else if (opened) {
+        pushed = job_queue_.push(job, deadline, policy, evicted);
+    }
+    if (pushed == JobQueue::PushStatus::Merged) {
         jobs_in_progress_--;
-        throw std::runtime_error("Cannot submit job: queue rejected enqueue during shutdown");
+        if (job.metadata.strand_key != 0) strand_done(job.metadata.strand_key); // opened above, never runs
+        if (tracing) JobTracer::instance().record(JobTracer::Phase::Abort, job.metadata);
+        Metrics::instance().job_coalesced().Increment();
+        JOB_LOG_INFO("Job {} (ID: {}) coalesced into queued job with key {}", job.metadata.name, job.metadata.id,
+                     job.metadata.coalesce_key);
+        return SubmitStatus::Coalesced;
+    }
+    if (pushed != JobQueue::PushStatus::Ok) {
+        jobs_in_progress_--;
+        if (opened && job.metadata.strand_key != 0) strand_done(job.metadata.strand_key);
+        if (tracing) JobTracer::instance().record(JobTracer::Phase::Abort, job.metadata);
+        if (pushed == JobQueue::PushStatus::Shutdown) return SubmitStatus::Shutdown;
+        Metrics::instance().job_rejected().Increment();
+        if (pushed == JobQueue::PushStatus::Overloaded) {
+            JOB_LOG_WARN("Job {} (ID: {}) rejected: shedding load", job.metadata.name, job.metadata.id);
+            return SubmitStatus::Overloaded;
+        }
+        JOB_LOG_WARN("Job {} (ID: {}) rejected: queue full", job.metadata.name, job.metadata.id);
+        return pushed == JobQueue::PushStatus::Timeout ? SubmitStatus::Timeout : SubmitStatus::Rejected;
     }
+    if (tracing) JobTracer::instance().record(JobTracer::Phase::Enqueue, traced);
     Metrics::instance().job_submitted().Increment();
     Metrics::instance().active_jobs().Increment();
+    if (held) Metrics::instance().strand_deferred().Increment();
+    if (evicted) drop_evicted(*evicted, "Job evicted from full queue by overflow policy");
+    return SubmitStatus::Accepted;
+}
+
+// A queued job evicted by the overflow policy or load shedding ends like one cancelled
+// before running.
+void ThreadPool::drop_evicted(JobQueue::Job& job, const char* reason) {
+    JOB_LOG_WARN("Job {} (ID: {}, priority {}): {}", job.metadata.name, job.metadata.id, job.metadata.priority,
+                 reason);
+    JobTracer::instance().record(JobTracer::Phase::Abort, job.metadata);
+    if (JobRecorder::enabled() && job.metadata.current_retry == 0) {
+        JobRecorder::instance().record(job.metadata, std::chrono::steady_clock::now(), 0, JobRecorder::kCancelled);
+    }
+    complete_terminal_failure(job, make_runtime_exception_ptr(reason));
+    Metrics::instance().job_dropped().Increment();
+    Metrics::instance().job_failed().Increment();
+    Metrics::instance().active_jobs().Decrement();
+    notify_job_finished(job.metadata);
+}
+
+// The first job of an idle key goes to the queue and opens the strand; later ones wait in
+// it once they hold a reserved slot.
+ThreadPool::StrandEntry ThreadPool::enter_strand(JobQueue::Job& job, bool slot_reserved) {
+    std::lock_guard<std::mutex> lock(strands_mutex_);
+    auto it = strands_.find(job.metadata.strand_key);
+    if (it == strands_.end()) {
+        strands_.try_emplace(job.metadata.strand_key);
+        return StrandEntry::Opened;
+    }
+    if (!slot_reserved) return StrandEntry::NeedsSlot;
+    it->second.pending.push_back(std::move(job));
+    return StrandEntry::Held;
+}
+
+// The key's current job has ended; start its next one, or close the strand.
+void ThreadPool::strand_done(uint64_t key) {
+    std::optional<JobQueue::Job> next;
+    bool handoff = false;
+    {
+        std::lock_guard<std::mutex> lock(strands_mutex_);
+        auto it = strands_.find(key);
+        if (it == strands_.end()) return;
+        Strand& strand = it->second;
+        if (strand.pending.empty()) {
+            strands_.erase(it);
+            return;
+        }
+        next.emplace(std::move(strand.pending.front()));
+        strand.pending.pop_front();
+        // While shutting down, hand off regardless of the burst so strands drain like the queue.
+        StrandHandoff* local = current_handoff;
+        handoff = local != nullptr && local->pool == this && !local->next &&
+                  next->metadata.priority <= local->max_priority && (strand.burst < kStrandBurst || !running_);
+        strand.burst = handoff ? strand.burst + 1 : 0;
+    }
+    if (handoff) {
+        job_queue_.release(); // runs now, off the queue
+        current_handoff->next = std::move(next);
+        Metrics::instance().strand_handoff().Increment();
+        return;
+    }
+    if (job_queue_.requeue(*next)) {
+        return;
+    }
+
+    // The queue is shut down: the rest of the key can never run.
+    std::deque<JobQueue::Job> orphaned;
+    {
+        std::lock_guard<std::mutex> lock(strands_mutex_);
+        auto it = strands_.find(key);
+        if (it != strands_.end()) {
+            orphaned.swap(it->second.pending);
+            strands_.erase(it);
+        }
+    }
+    next->metadata.strand_key = 0; // already closed above
+    drop_evicted(*next, "Strand job dropped: queue shut down");
+    for (auto& job : orphaned) {
+        job_queue_.release();
+        job.metadata.strand_key = 0;
+        drop_evicted(job, "Strand job dropped: queue shut down");
+    }
 }
 
 void ThreadPool::shutdown(int timeout_seconds) {
@@ -76,6 +360,9 @@ void ThreadPool::shutdown(int timeout_seconds) {
     running_ = false;
     shutdown_cv_.notify_all();
     job_queue_.shutdown();
+    if (watchdog_.joinable()) {
+        watchdog_.join();
+    }
     spdlog::info("Waiting for {} jobs to finish", jobs_in_progress_.load());
     std::unique_lock<std::mutex> lock(done_mutex_);
     bool finished = cv_done_.wait_for(lock, std::chrono::seconds(timeout_seconds), [this]() {
@@ -92,15 +379,220 @@ void ThreadPool::shutdown(int timeout_seconds) {
             worker.join();//block here until that thread finishes
         }
     }
+    // running_ is false, so no more compensating workers start; take the threads out of
+    // the mutex before joining, since a running job may still open a blocking section.
+    std::vector<std::thread> compensating;
+    {
+        std::lock_guard<std::mutex> spares(compensating_mutex_);
+        compensating.swap(compensating_threads_);
+    }
+    for (auto& worker : compensating) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
     spdlog::info("Shutdown complete.");
+    if (JobTracer::enabled()) {
+        try {
+            JobTracer::instance().dump_if_configured();
+        } catch (const std::exception& e) {
+            spdlog::error("Failed to write job trace: {}", e.what());
+        }
+    }
     spdlog::info("Active jobs:    {}", Metrics::instance().active_jobs().Value());
 }
 
-void ThreadPool::worker_loop() {
+PoolContentionStats ThreadPool::contention_stats() {
+    PoolContentionStats stats;
+    stats.queue = job_queue_.contention();
+    stats.workers.resize(workers_.size());
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        stats.workers[i].busy_ns = worker_stats_[i].busy_ns.load(std::memory_order_relaxed);
+        stats.workers[i].idle_ns = worker_stats_[i].idle_ns.load(std::memory_order_relaxed);
+        stats.workers[i].jobs = worker_stats_[i].jobs.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+LaneStats ThreadPool::lane_stats() const {
+    LaneStats stats;
+    if (!lanes_enabled_) {
+        return stats;
+    }
+    const double elapsed_ns = static_cast<double>(contention::now_ns() - lanes_since_ns_);
+    uint64_t wait_ns[2] = {0, 0}, max_ns[2] = {0, 0}, run_ns[2] = {0, 0};
+    LaneClassStats* classes[2] = {&stats.reserved, &stats.shared};
+    for (size_t i = 0; i < slot_count_; ++i) {
+        const WorkerSlot& slot = worker_stats_[i];
+        const size_t worker_class = i < lane_options_.reserved_workers ? 0 : 1;
+        if (i < base_workers_) ++classes[worker_class]->workers;
+        run_ns[worker_class] += slot.lane_run_ns.load(std::memory_order_relaxed);
+        classes[worker_class]->jobs += slot.lane_jobs.load(std::memory_order_relaxed);
+        classes[worker_class]->borrowed += slot.lane_borrowed.load(std::memory_order_relaxed);
+        for (size_t c = 0; c < 2; ++c) {
+            classes[c]->waits += slot.lane_wait[c].count.load(std::memory_order_relaxed);
+            wait_ns[c] += slot.lane_wait[c].total_ns.load(std::memory_order_relaxed);
+            max_ns[c] = std::max(max_ns[c], slot.lane_wait[c].max_ns.load(std::memory_order_relaxed));
+        }
+    }
+    for (size_t c = 0; c < 2; ++c) {
+        LaneClassStats& cls = *classes[c];
+        cls.utilization = cls.workers > 0 && elapsed_ns > 0 ? run_ns[c] / (elapsed_ns * cls.workers) : 0.0;
+        cls.mean_wait_seconds = cls.waits > 0 ? wait_ns[c] / 1e9 / cls.waits : 0.0;
+        cls.max_wait_seconds = max_ns[c] / 1e9;
+    }
+    return stats;
+}
+
+WatchdogStats ThreadPool::watchdog_stats() const {
+    WatchdogStats stats;
+    stats.compensating_workers = compensating_.load(std::memory_order_relaxed);
+    stats.blocked_workers = blocked_.load(std::memory_order_relaxed);
+    if (!watchdog_enabled_) {
+        return stats;
+    }
+    const uint64_t threshold_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(watchdog_options_.stuck_threshold).count());
+    const uint64_t now = contention::now_ns();
+    uint64_t longest_ns = 0;
+    for (size_t i = 0; i < slot_count_; ++i) {
+        const uint64_t started = worker_stats_[i].job_started_ns.load(std::memory_order_acquire);
+        if (started == 0 || started > now) continue;
+        const uint64_t age = now - started;
+        if (age >= threshold_ns) ++stats.stuck_workers;
+        if (age > longest_ns) {
+            longest_ns = age;
+            stats.longest_running_job_id = worker_stats_[i].job_id.load(std::memory_order_relaxed);
+        }
+    }
+    stats.longest_running_seconds = static_cast<double>(longest_ns) * 1e-9;
+    stats.stuck_jobs_total = stuck_jobs_total_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ThreadPool::watchdog_loop() {
+    const uint64_t threshold_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(watchdog_options_.stuck_threshold).count());
+    std::vector<uint64_t> reported(slot_count_, 0); // start time of the job last flagged per slot
+
+    std::unique_lock<std::mutex> lock(shutdown_mutex_);
+    while (!shutdown_cv_.wait_for(lock, watchdog_options_.check_interval, [this]() { return !running_.load(); })) {
+        lock.unlock();
+        const uint64_t now = contention::now_ns();
+        size_t stuck = 0;
+        for (size_t i = 0; i < slot_count_; ++i) {
+            const uint64_t started = worker_stats_[i].job_started_ns.load(std::memory_order_acquire);
+            if (started == 0 || started > now || now - started < threshold_ns) continue;
+            ++stuck;
+            if (reported[i] != started) {
+                reported[i] = started;
+                stuck_jobs_total_.fetch_add(1, std::memory_order_relaxed);
+                spdlog::warn("Worker {} stuck on job ID {} for {}ms", i,
+                             worker_stats_[i].job_id.load(std::memory_order_relaxed), (now - started) / 1000000);
+            }
+        }
+        if (watchdog_options_.max_compensating_workers > 0) {
+            stuck_target_.store(std::min(stuck, watchdog_options_.max_compensating_workers), std::memory_order_relaxed);
+            add_compensating_workers();
+        }
+        lock.lock();
+    }
+}
+
+// Stuck workers seen by the watchdog plus open blocking sections, each within its cap.
+size_t ThreadPool::compensating_target() const {
+    return stuck_target_.load(std::memory_order_relaxed) +
+           std::min(blocked_.load(std::memory_order_relaxed), watchdog_options_.max_blocking_workers);
+}
+
+// Surplus workers retire themselves in worker_loop.
+void ThreadPool::add_compensating_workers() {
+    std::lock_guard<std::mutex> lock(compensating_mutex_);
+    if (!running_) return;
+    const size_t target = compensating_target();
+    for (size_t i = base_workers_; i < slot_count_ && compensating_.load() < target; ++i) {
+        WorkerSlot& slot = worker_stats_[i];
+        if (slot.live.load(std::memory_order_acquire)) continue;
+        std::thread& thread = compensating_threads_[i - base_workers_];
+        if (thread.joinable()) {
+            thread.join(); // a retired worker; it has already left worker_loop
+        }
+        slot.live.store(true, std::memory_order_relaxed);
+        compensating_.fetch_add(1);
+        thread = std::thread(&ThreadPool::worker_loop, this, i);
+        spdlog::warn("Started compensating worker {} ({} running)", i, compensating_.load());
+    }
+}
+
+ThreadPool::BlockingSection::BlockingSection(ThreadPool& pool) : pool_(pool) {
+    const size_t blocked = pool_.blocked_.fetch_add(1) + 1;
+    if (blocked <= pool_.watchdog_options_.max_blocking_workers &&
+        pool_.compensating_.load() < pool_.compensating_target()) {
+        pool_.add_compensating_workers();
+    }
+}
+
+ThreadPool::BlockingSection::~BlockingSection() {
+    pool_.blocked_.fetch_sub(1); // the extra worker retires at its next job boundary
+}
+
+bool ThreadPool::retire_compensating_worker() {
+    size_t live = compensating_.load();
+    while (live > compensating_target()) {
+        if (compensating_.compare_exchange_weak(live, live - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    WorkerSlot& slot = worker_stats_[index];
+#ifdef JOBQUEUE_CONTENTION_STATS
+    uint64_t mark = contention::now_ns();
+#endif
+    std::vector<JobQueue::Job> shed;
+    const bool reserved = index < lane_options_.reserved_workers;
+    StrandHandoff handoff;
+    handoff.pool = this;
+    if (reserved) handoff.max_priority = lane_options_.max_priority;
+    current_handoff = &handoff;
+    bool retired = false; // a spare that left through retire_compensating_worker()
     while (true) {
-        JobQueue::Job job = job_queue_.pop();
-        if (job_queue_.is_shutdown() && job.metadata.id == -1) {
-            break;
+        JobQueue::Job job;
+        if (handoff.next) {
+            job = std::move(*handoff.next);
+            handoff.next.reset();
+        } else {
+            if (index >= base_workers_ && retire_compensating_worker()) {
+                retired = true;
+                break;
+            }
+#ifdef JOBQUEUE_CONTENTION_STATS
+            const uint64_t pop_start = contention::now_ns();
+            bump(slot.busy_ns, pop_start - mark);
+#endif
+            job = reserved ? job_queue_.pop_lane(&shed) : job_queue_.pop(&shed);
+#ifdef JOBQUEUE_CONTENTION_STATS
+            mark = contention::now_ns();
+            bump(slot.idle_ns, mark - pop_start);
+#endif
+            for (auto& dropped : shed) {
+                drop_evicted(dropped, "Job shed: queue wait above target");
+            }
+            shed.clear();
+            if (job_queue_.is_shutdown() && job.metadata.id == -1) {
+                if (handoff.next) continue; // a shed job's strand handed its next job here
+                break;
+            }
+        }
+#ifdef JOBQUEUE_CONTENTION_STATS
+        bump(slot.jobs, 1);
+#endif
+        JobTracer::instance().record(JobTracer::Phase::Pop, job.metadata);
+        if (job.metadata.batch_key != 0) {
+            run_batch(std::move(job), slot, reserved);
+            continue;
         }
 
         // Previous non-blocking worker path kept for reference:
@@ -112,52 +604,97 @@ void ThreadPool::worker_loop() {
         //     }        
 
         if (job.metadata.cancel_requested) {
-            spdlog::warn("Job {} (ID: {}) cancelled before execution",
+            JOB_LOG_WARN("Job {} (ID: {}) cancelled before execution",
                          job.metadata.name, job.metadata.id);
+            JobTracer::instance().record(JobTracer::Phase::Cancel, job.metadata);
+            if (JobRecorder::enabled() && job.metadata.current_retry == 0) {
+                JobRecorder::instance().record(job.metadata, std::chrono::steady_clock::now(), 0, JobRecorder::kCancelled);
+            }
             complete_terminal_failure(job, make_runtime_exception_ptr("Job cancelled before execution"));
             Metrics::instance().job_failed().Increment();
             Metrics::instance().active_jobs().Decrement();
-            notify_job_finished();
+            notify_job_finished(job.metadata);
             continue;
         }
 
         bool timed_out = false;
         bool retried = false;
+        const int series = job.metadata.metrics_series;
+        const auto start = std::chrono::steady_clock::now();
+        const bool profiling = JobProfiler::enabled();
+        const bool recording = JobRecorder::enabled() && job.metadata.current_retry == 0;
+        JobProfiler::Sample cost;
+        const int priority = job.metadata.priority;
+        if (job.metadata.current_retry == 0) {
+            const auto wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start - job.metadata.enqueue_time).count();
+            Metrics::instance().job_queue_wait(series).ObserveNanos(wait_ns);
+            if (lanes_enabled_) note_lane_wait(slot, priority, wait_ns);
+        }
 
         try {
-            auto start = std::chrono::steady_clock::now();
             if (job.metadata.timeout.count() > 0) {
                 const auto deadline = job.metadata.enqueue_time + job.metadata.timeout;
                 if (start >= deadline) {
                     job.metadata.cancel_requested = true;
                     timed_out = true;
-                    spdlog::warn("Job {} (ID: {}) expired before execution after waiting {}ms",
+                    JOB_LOG_WARN("Job {} (ID: {}) expired before execution after waiting {}ms",
                                  job.metadata.name, job.metadata.id, job.metadata.timeout.count());
+                    JobTracer::instance().record(JobTracer::Phase::Expire, job.metadata);
+                    if (recording) JobRecorder::instance().record(job.metadata, start, 0, JobRecorder::kExpired);
                     complete_terminal_failure(job, make_runtime_exception_ptr("Job expired before execution"));
                     Metrics::instance().job_failed().Increment();
                 }
             }
 
             if (!timed_out) {
-                spdlog::info("Running job ID = {}, Name = {}, on thread {}",
+                JOB_LOG_INFO("Running job ID = {}, Name = {}, on thread {}",
                              job.metadata.id, job.metadata.name, std::this_thread::get_id());
-                job.task();
+                JobTracer::instance().record(JobTracer::Phase::Start, job.metadata);
+                if (profiling) cost = JobProfiler::instance().begin();
+                {
+                    RunningJobMark running(watchdog_enabled_ ? &slot.job_started_ns : nullptr, slot.job_id,
+                                           job.metadata.id);
+                    std::optional<BlockingSection> blocking;
+                    if (job.metadata.blocking) blocking.emplace(*this);
+                    job.task();
+                }
+                if (profiling) JobProfiler::instance().record(job.metadata.name, cost);
+                JobTracer::instance().record(JobTracer::Phase::Finish, job.metadata);
                 Metrics::instance().job_completed().Increment();
                 auto end = std::chrono::steady_clock::now();
                 std::chrono::duration<double> latency = end - start;
+                if (recording) {
+                    JobRecorder::instance().record(
+                        job.metadata, start,
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), 0);
+                }
+                Metrics::instance().job_execution(series).ObserveNanos(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
                 if (!job.metadata.cancel_requested) {
                     Metrics::instance().job_latency().Observe(latency.count());
+                    Metrics::instance().job_end_to_end(series).ObserveNanos(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(end - job.metadata.enqueue_time).count());
                 }
             }
 
             Metrics::instance().active_jobs().Decrement();
         } catch (const std::future_error& e) {
-            spdlog::warn("Future error in job {} (ID {}): {}", job.metadata.name, job.metadata.id, e.what());
+            JOB_LOG_WARN("Future error in job {} (ID {}): {}", job.metadata.name, job.metadata.id, e.what());
+            JobTracer::instance().record(JobTracer::Phase::Fail, job.metadata);
             Metrics::instance().job_failed().Increment();
             Metrics::instance().active_jobs().Decrement();
         } catch (const std::exception& ex) {
-            spdlog::error("Job {} (ID: {}) failed: {}", job.metadata.name, job.metadata.id, ex.what());
-            spdlog::info("Retry check: allow_retry={}, cancel={}, cur={}, max={}",
+            if (profiling && !timed_out) JobProfiler::instance().record(job.metadata.name, cost);
+            if (recording && !timed_out) {
+                JobRecorder::instance().record(
+                    job.metadata, start,
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(),
+                    JobRecorder::kFailed);
+            }
+            Metrics::instance().job_execution(series).ObserveNanos(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            JOB_LOG_ERROR("Job {} (ID: {}) failed: {}", job.metadata.name, job.metadata.id, ex.what());
+            JOB_LOG_INFO("Retry check: allow_retry={}, cancel={}, cur={}, max={}",
                          job.metadata.allow_retry,
                          job.metadata.cancel_requested.load(),
                          job.metadata.current_retry,
@@ -165,45 +702,50 @@ void ThreadPool::worker_loop() {
 
             if (!job.metadata.cancel_requested &&job.metadata.allow_retry &&
                 job.metadata.current_retry < job.metadata.max_retries) {
-                spdlog::warn("Retrying job {} (ID: {}) [attempt {}/{}]",job.metadata.name, job.metadata.id,
+                JOB_LOG_WARN("Retrying job {} (ID: {}) [attempt {}/{}]",job.metadata.name, job.metadata.id,
                              job.metadata.current_retry + 1, job.metadata.max_retries);
+                JobTracer::instance().record(JobTracer::Phase::Retry, job.metadata);
                 job.metadata.current_retry++;
                 const auto retry_delay = compute_retry_delay(job.metadata);
                 if (retry_delay.count() > 0) {
-                    spdlog::info("Applying retry backoff of {}ms for job {} (ID: {})",
+                    JOB_LOG_INFO("Applying retry backoff of {}ms for job {} (ID: {})",
                                  retry_delay.count(), job.metadata.name, job.metadata.id);
                     if (!wait_for_retry_delay_or_shutdown(retry_delay)) {
-                        spdlog::warn("Retry backoff interrupted by shutdown for job {} (ID: {})",
+                        JOB_LOG_WARN("Retry backoff interrupted by shutdown for job {} (ID: {})",
                                      job.metadata.name, job.metadata.id);
+                        JobTracer::instance().record(JobTracer::Phase::Abort, job.metadata);
                         complete_terminal_failure(job, make_runtime_exception_ptr("Retry interrupted by shutdown"));
                         Metrics::instance().job_failed().Increment();
                         Metrics::instance().active_jobs().Decrement();
-                        notify_job_finished();
+                        notify_job_finished(job.metadata);
                         continue;
                     }
                 }
                 if (!running_) {
-                    spdlog::warn("Retry skipped because shutdown has started for job {} (ID: {})",
+                    JOB_LOG_WARN("Retry skipped because shutdown has started for job {} (ID: {})",
                                  job.metadata.name, job.metadata.id);
+                    JobTracer::instance().record(JobTracer::Phase::Abort, job.metadata);
                     complete_terminal_failure(job, make_runtime_exception_ptr("Retry skipped during shutdown"));
                     Metrics::instance().job_failed().Increment();
                     Metrics::instance().active_jobs().Decrement();
-                    notify_job_finished();
+                    notify_job_finished(job.metadata);
                     continue;
                 }
                 if (job_queue_.push(std::move(job))) {
                     retried = true;
                 } else {
-                    spdlog::warn("Retry requeue rejected for job {} (ID: {}) during shutdown",
+                    JOB_LOG_WARN("Retry requeue rejected for job {} (ID: {}) during shutdown",
                                  job.metadata.name, job.metadata.id);
+                    JobTracer::instance().record(JobTracer::Phase::Abort, job.metadata);
                     complete_terminal_failure(job, make_runtime_exception_ptr("Retry requeue rejected during shutdown"));
                 }
             } else {
                 if (job.metadata.allow_retry) {
-                    spdlog::info("Job {} (ID: {}) not retried: timed_out={}, current_retry={}, max_retries={}",
+                    JOB_LOG_INFO("Job {} (ID: {}) not retried: timed_out={}, current_retry={}, max_retries={}",
                                  job.metadata.name, job.metadata.id, timed_out,
                                  job.metadata.current_retry, job.metadata.max_retries);
                 }
+                JobTracer::instance().record(JobTracer::Phase::Fail, job.metadata);
                 complete_terminal_failure(job, std::current_exception());
             }
 
@@ -212,16 +754,151 @@ void ThreadPool::worker_loop() {
                 Metrics::instance().active_jobs().Decrement();
             }
         } catch (...) {
-            spdlog::error("Job {} (ID: {}) failed with unknown error", job.metadata.name, job.metadata.id);
+            if (profiling && !timed_out) JobProfiler::instance().record(job.metadata.name, cost);
+            if (recording && !timed_out) {
+                JobRecorder::instance().record(
+                    job.metadata, start,
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(),
+                    JobRecorder::kFailed);
+            }
+            JOB_LOG_ERROR("Job {} (ID: {}) failed with unknown error", job.metadata.name, job.metadata.id);
+            JobTracer::instance().record(JobTracer::Phase::Fail, job.metadata);
             complete_terminal_failure(job, make_runtime_exception_ptr("Job failed with unknown error"));
             Metrics::instance().job_failed().Increment();
             Metrics::instance().active_jobs().Decrement();
         }
 
+        if (lanes_enabled_) {
+            note_lane_run(slot, reserved, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                              std::chrono::steady_clock::now() - start).count(),
+                          1, reserved && priority > lane_options_.max_priority ? 1 : 0);
+        }
+
         if (!retried) {
-            notify_job_finished();
+            notify_job_finished(job.metadata);
+        }
+    }
+    current_handoff = nullptr;
+    // A spare still counted when shutdown ends the loop gives its count back here.
+    if (index >= base_workers_ && !retired) compensating_.fetch_sub(1);
+    slot.live.store(false, std::memory_order_release);
+}
+
+// One handler call for head and the queued jobs of its batch key. Each job keeps its own
+// accounting (queue wait, completion or failure, active_jobs), as if it had run alone.
+void ThreadPool::note_lane_wait(WorkerSlot& slot, int priority, int64_t wait_ns) {
+    auto& wait = slot.lane_wait[priority <= lane_options_.max_priority ? 0 : 1];
+    bump(wait.count, 1);
+    bump(wait.total_ns, static_cast<uint64_t>(std::max<int64_t>(0, wait_ns)));
+    if (static_cast<uint64_t>(wait_ns) > wait.max_ns.load(std::memory_order_relaxed)) {
+        wait.max_ns.store(static_cast<uint64_t>(wait_ns), std::memory_order_relaxed);
+    }
+}
+
+void ThreadPool::note_lane_run(WorkerSlot& slot, bool reserved, int64_t run_ns, uint64_t jobs, uint64_t borrowed) {
+    bump(slot.lane_run_ns, static_cast<uint64_t>(std::max<int64_t>(0, run_ns)));
+    bump(slot.lane_jobs, jobs);
+    if (reserved) bump(slot.lane_borrowed, borrowed);
+}
+
+void ThreadPool::run_batch(JobQueue::Job head, WorkerSlot& slot, bool reserved) {
+    std::vector<JobQueue::Job> batch;
+    batch.push_back(std::move(head));
+    // A reserved worker that borrowed the head still only adds jobs from its lane.
+    job_queue_.take_batch(batch, reserved ? lane_options_.max_priority : std::numeric_limits<int>::max());
+    std::shared_ptr<BatchRunner> runner;
+    {
+        std::lock_guard<std::mutex> lock(batch_mutex_);
+        const auto found = batch_runners_.find(batch.front().metadata.batch_key);
+        if (found != batch_runners_.end()) runner = found->second;
+    }
+    if (!runner) { // submits check the key, so only a job built around them gets here
+        for (auto& job : batch) {
+            JOB_LOG_ERROR("Job {} (ID: {}) has no batch handler for key {}", job.metadata.name, job.metadata.id,
+                          job.metadata.batch_key);
+            JobTracer::instance().record(JobTracer::Phase::Fail, job.metadata);
+            complete_terminal_failure(job, make_runtime_exception_ptr("No batch handler registered for its batch_key"));
+            Metrics::instance().job_failed().Increment();
+            Metrics::instance().active_jobs().Decrement();
+            notify_job_finished(job.metadata);
+        }
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<JobQueue::Job> ready;
+    ready.reserve(batch.size());
+    for (auto& job : batch) {
+        if (job.metadata.current_retry == 0) {
+            const auto wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start - job.metadata.enqueue_time).count();
+            Metrics::instance().job_queue_wait(job.metadata.metrics_series).ObserveNanos(wait_ns);
+            if (lanes_enabled_) note_lane_wait(slot, job.metadata.priority, wait_ns);
+        }
+        const bool expired = job.metadata.timeout.count() > 0 && start >= job.metadata.enqueue_time + job.metadata.timeout;
+        if (job.metadata.cancel_requested || expired) {
+            JobTracer::instance().record(expired ? JobTracer::Phase::Expire : JobTracer::Phase::Cancel, job.metadata);
+            if (JobRecorder::enabled() && job.metadata.current_retry == 0) {
+                JobRecorder::instance().record(job.metadata, start, 0,
+                                               expired ? JobRecorder::kExpired : JobRecorder::kCancelled);
+            }
+            complete_terminal_failure(job, make_runtime_exception_ptr(expired ? "Job expired before execution"
+                                                                              : "Job cancelled before execution"));
+            Metrics::instance().job_failed().Increment();
+            Metrics::instance().active_jobs().Decrement();
+            notify_job_finished(job.metadata);
+            continue;
         }
+        JobTracer::instance().record(JobTracer::Phase::Start, job.metadata);
+        ready.push_back(std::move(job));
+    }
+    if (ready.empty()) {
+        return;
     }
+
+    JOB_LOG_INFO("Running batch of {} jobs for key {} on thread {}", ready.size(), ready.front().metadata.batch_key,
+                 std::this_thread::get_id());
+    Metrics::instance().job_batches().Increment();
+    std::exception_ptr failure;
+    {
+        RunningJobMark running(watchdog_enabled_ ? &slot.job_started_ns : nullptr, slot.job_id,
+                               ready.front().metadata.id);
+        const bool blocking = std::any_of(ready.begin(), ready.end(),
+                                          [](const JobQueue::Job& job) { return job.metadata.blocking; });
+        std::optional<BlockingSection> section;
+        if (blocking) section.emplace(*this);
+        try {
+            runner->run(ready);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    const auto run_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    // Recordings replay each job on its own, so each item gets its share of the handler call.
+    const int64_t share_ns = run_ns / static_cast<int64_t>(ready.size());
+    uint64_t borrowed = 0;
+    for (auto& job : ready) {
+        Metrics::instance().job_execution(job.metadata.metrics_series).ObserveNanos(run_ns);
+        if (JobRecorder::enabled() && job.metadata.current_retry == 0) {
+            JobRecorder::instance().record(job.metadata, start, share_ns, failure ? JobRecorder::kFailed : 0);
+        }
+        if (job.metadata.priority > lane_options_.max_priority) ++borrowed;
+        if (failure) {
+            JOB_LOG_ERROR("Batched job {} (ID: {}) failed with its batch", job.metadata.name, job.metadata.id);
+            JobTracer::instance().record(JobTracer::Phase::Fail, job.metadata);
+            complete_terminal_failure(job, failure);
+            Metrics::instance().job_failed().Increment();
+        } else {
+            JobTracer::instance().record(JobTracer::Phase::Finish, job.metadata);
+            Metrics::instance().job_completed().Increment();
+            Metrics::instance().job_end_to_end(job.metadata.metrics_series).ObserveNanos(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - job.metadata.enqueue_time).count());
+        }
+        Metrics::instance().active_jobs().Decrement();
+        notify_job_finished(job.metadata);
+    }
+    if (lanes_enabled_) note_lane_run(slot, reserved, run_ns, ready.size(), borrowed);
 }
 
 void ThreadPool::complete_terminal_failure(JobQueue::Job& job, std::exception_ptr ex) {
@@ -232,12 +909,15 @@ void ThreadPool::complete_terminal_failure(JobQueue::Job& job, std::exception_pt
     try {
         job.on_terminal_failure(std::move(ex));
     } catch (const std::future_error& e) {
-        spdlog::warn("Failed to complete promise for job {} (ID: {}): {}",
+        JOB_LOG_WARN("Failed to complete promise for job {} (ID: {}): {}",
                      job.metadata.name, job.metadata.id, e.what());
     }
 }
 
-void ThreadPool::notify_job_finished() {
+void ThreadPool::notify_job_finished(const JobMetadata& metadata) {
+    if (metadata.strand_key != 0) {
+        strand_done(metadata.strand_key);
+    }
     jobs_in_progress_--;
     if (jobs_in_progress_ == 0) {
         std::unique_lock lock(done_mutex_);
@@ -1,6 +1,12 @@
 #include <catch2/catch_all.hpp>
 #include "LRUCache.hpp"
+#include "LRUCacheSnapshot.hpp"
+#include <cstdio>
+#include <fstream>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 int main(int argc, char* argv[]) {
     return Catch::Session().run(argc, argv);
@@ -34,3 +40,100 @@ TEST_CASE("LRUCache Overwrite and Access", "[LRUCache]") {
     cache.put("z", 30); // Evicts "y"
     REQUIRE_FALSE(cache.get("y", val));
 }
+
+TEST_CASE("LRUCache get_shared returns the stored value without copying", "[LRUCache]") {
+    LRUCache<std::string, std::vector<int>> cache(2);
+    cache.put("big", std::vector<int>(1000, 7));
+
+    auto first = cache.get_shared("big");
+    auto second = cache.get_shared("big");
+    REQUIRE(first != nullptr);
+    REQUIRE(first.get() == second.get());
+    REQUIRE(first->size() == 1000);
+
+    REQUIRE(cache.get_shared("missing") == nullptr);
+}
+
+TEST_CASE("LRUCache shared handle outlives eviction", "[LRUCache]") {
+    LRUCache<std::string, std::string> cache(1);
+    cache.put("a", std::string("alpha"));
+    auto handle = cache.get_shared("a");
+
+    cache.put("b", std::string("beta")); // Evicts "a"
+    REQUIRE_FALSE(cache.exists("a"));
+    REQUIRE(*handle == "alpha");
+}
+
+TEST_CASE("LRUCache accepts move-only values and emplace", "[LRUCache]") {
+    LRUCache<int, std::unique_ptr<int>> cache(2);
+    cache.put(1, std::make_unique<int>(10));
+    cache.emplace(2, new int(20));
+
+    REQUIRE(**cache.get_shared(1) == 10);
+    REQUIRE(**cache.get_shared(2) == 20);
+    REQUIRE(cache.size() == 2);
+}
+
+TEST_CASE("LRUCache string keys can be looked up by string_view", "[LRUCache]") {
+    LRUCache<std::string, int> cache(2);
+    cache.put(std::string("ComputeAnswer42"), 42);
+
+    const char buffer[] = "ComputeAnswer42-suffix";
+    std::string_view key(buffer, 15);
+
+    int val = 0;
+    REQUIRE(cache.get(key, val));
+    REQUIRE(val == 42);
+    REQUIRE(cache.exists(key));
+
+    cache.put("x", 1);
+    cache.put("y", 2); // Evicts "ComputeAnswer42"
+    REQUIRE_FALSE(cache.exists(key));
+}
+
+TEST_CASE("LRUCache snapshot restores lazily and keeps LRU order", "[LRUCache][snapshot]") {
+    const std::string path = "test_lru_snapshot.bin";
+    {
+        LRUCache<std::string, int> cache(3);
+        cache.put("a", 1);
+        cache.put("b", 2);
+        cache.put("c", 3);
+        int val;
+        REQUIRE(cache.get("a", val)); // "b" is now least recently used
+        save_snapshot(cache, path);
+    }
+
+    LRUCache<std::string, int> restored(3);
+    auto snapshot = LRUCacheSnapshot<std::string, int>::attach(restored, path);
+    REQUIRE(snapshot->size() == 3);
+    REQUIRE(restored.size() == 0); // nothing decoded at open
+
+    int val = 0;
+    REQUIRE(restored.get("c", val)); // read-through from the snapshot
+    REQUIRE(val == 3);
+    REQUIRE(snapshot->remaining() == 2);
+
+    restored.put("a", 100); // supersedes the snapshot copy
+    REQUIRE(snapshot->materialize(restored) == 1); // only "b" is left to replay
+    REQUIRE(snapshot->remaining() == 0);
+
+    REQUIRE(restored.get("a", val));
+    REQUIRE(val == 100);
+    REQUIRE(restored.get("b", val));
+    REQUIRE(val == 2);
+    REQUIRE_FALSE(restored.get("missing", val));
+    REQUIRE(snapshot.use_count() == 1); // drained: the cache let go of the mapping
+
+    snapshot.reset();
+    std::remove(path.c_str());
+}
+
+TEST_CASE("LRUCache snapshot rejects files that are not snapshots", "[LRUCache][snapshot]") {
+    const std::string path = "test_lru_not_a_snapshot.bin";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "definitely not a snapshot file, but long enough for a header";
+    }
+    REQUIRE_THROWS_AS((LRUCacheSnapshot<int, int>::open(path)), std::runtime_error);
+    std::remove(path.c_str());
+}
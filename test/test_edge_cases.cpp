@@ -1,11 +1,41 @@
 #include <catch2/catch_all.hpp>
 #include "JobQueue.hpp"
 #include "ThreadPool.hpp"
+#include "LoadingCache.hpp"
+#include "JobTracer.hpp"
+#include "JobProfiler.hpp"
+#include "JobRecorder.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <sstream>
 
 int main(int argc, char* argv[]) {
     return Catch::Session().run(argc, argv);
 }
 
+#if defined(__linux__)
+// Interposes read() so a test can run code at an exact point inside a drain().
+namespace {
+int read_hook_fd = -1;
+std::function<void()> read_hook;
+}
+
+extern "C" ssize_t read(int fd, void* buf, size_t count) {
+    if (fd == read_hook_fd && read_hook) {
+        auto hook = std::move(read_hook);
+        read_hook = nullptr;
+        hook();
+    }
+    return syscall(SYS_read, fd, buf, count);
+}
+#endif
+
 TEST_CASE("try_pop returns false when queue is empty") {
     JobQueue queue(10);
     JobQueue::Job job;
@@ -385,3 +415,754 @@ TEST_CASE("future job failure without retry completes with exception") {
 }
 
 
+
+TEST_CASE("submit_memoized runs one job for concurrent requests of the same key") {
+    ThreadPool pool(4, 64);
+    SingleFlightCache<std::string, int> cache(16);
+
+    std::atomic<int> computations = 0;
+    std::atomic<bool> release = false;
+    std::vector<std::shared_future<std::shared_ptr<const int>>> results;
+
+    for (int i = 0; i < 8; ++i) {
+        results.push_back(pool.submit_memoized(cache, JobMetadata(i, "memo"), "answer", [&] {
+            computations++;
+            while (!release.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return 42;
+        }));
+    }
+
+    release = true;
+    for (auto& result : results) {
+        REQUIRE(*result.get() == 42);
+    }
+    REQUIRE(computations == 1);
+    REQUIRE(results.front().get().get() == results.back().get().get());
+
+    auto cached = pool.submit_memoized(cache, JobMetadata(99, "memo"), "answer", [&] {
+        computations++;
+        return 0;
+    });
+    REQUIRE(cached.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready);
+    REQUIRE(*cached.get() == 42);
+    REQUIRE(computations == 1);
+
+    pool.shutdown(2);
+}
+
+TEST_CASE("submit_memoized failure reaches all waiters and is not cached") {
+    ThreadPool pool(1, 16);
+    SingleFlightCache<std::string, int> cache(16);
+
+    std::atomic<bool> release = false;
+    JobMetadata meta(1, "memo_fail");
+    meta.allow_retry = false;
+
+    auto first = pool.submit_memoized(cache, std::move(meta), "key", [&]() -> int {
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        throw std::runtime_error("expected failure");
+    });
+    auto second = pool.submit_memoized(cache, JobMetadata(2, "memo_fail"), "key", [] { return 1; });
+
+    release = true;
+    REQUIRE_THROWS_AS(first.get(), std::runtime_error);
+    REQUIRE_THROWS_AS(second.get(), std::runtime_error);
+    REQUIRE(cache.inflight() == 0);
+    REQUIRE_FALSE(cache.cache().exists("key"));
+
+    auto retry = pool.submit_memoized(cache, JobMetadata(3, "memo_fail"), "key", [] { return 7; });
+    REQUIRE(*retry.get() == 7);
+
+    pool.shutdown(2);
+}
+
+TEST_CASE("loading cache serves the old value while refreshing ahead") {
+    ThreadPool pool(2, 16);
+
+    std::atomic<int> loads = 0;
+    LoadingCache<std::string, int>::Options options;
+    options.refresh_after = std::chrono::milliseconds(30);
+    LoadingCache<std::string, int> cache(pool, options, [&](const std::string&) {
+        return ++loads;
+    });
+
+    REQUIRE(*cache.get("k") == 1);
+    REQUIRE(*cache.get("k") == 1);
+    REQUIRE(loads == 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE(*cache.get("k") == 1); // stale read returns old value and schedules a reload
+
+    while (cache.pending_refreshes() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(*cache.get("k") == 2);
+
+    pool.shutdown(2);
+}
+
+TEST_CASE("loading cache get_all batches missing keys into one load") {
+    ThreadPool pool(2, 16);
+
+    std::atomic<int> batches = 0;
+    LoadingCache<int, int> cache(pool, {}, [](const int& key) { return key * 10; },
+        [&](const std::vector<int>& keys) {
+            batches++;
+            std::vector<std::pair<int, int>> loaded;
+            for (int key : keys) {
+                loaded.emplace_back(key, key * 100);
+            }
+            return loaded;
+        });
+
+    REQUIRE(*cache.get(1) == 100);
+    REQUIRE(batches == 1);
+
+    auto values = cache.get_all({1, 2, 3, 4});
+    REQUIRE(values.size() == 4);
+    REQUIRE(*values[0] == 100);
+    REQUIRE(*values[3] == 400);
+    REQUIRE(batches == 2);
+
+    pool.shutdown(2);
+}
+
+TEST_CASE("job tracer writes Chrome trace events for the job lifecycle") {
+    const std::string path = "test_job_trace.json";
+    JobTracer::instance().enable(path, 1024);
+    {
+        ThreadPool pool(1, 10);
+        JobMetadata ok(1, "traced_ok");
+        pool.submit(std::move(ok), [] {});
+
+        JobMetadata flaky(2, "traced_\"flaky\"", 1);
+        auto attempts = std::make_shared<std::atomic<int>>(0);
+        pool.submit(std::move(flaky), [attempts] {
+            if (attempts->fetch_add(1) == 0) throw std::runtime_error("first attempt fails");
+        });
+        pool.shutdown();
+    }
+    JobTracer::instance().disable();
+
+    std::ifstream file(path);
+    REQUIRE(file.good());
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string json = buffer.str();
+    std::remove(path.c_str());
+
+    REQUIRE(json.find("\"traceEvents\"") != std::string::npos);
+    for (const char* phase : {"submit", "enqueue", "pop", "finish", "retry"}) {
+        REQUIRE(json.find(std::string("\"name\":\"") + phase + "\"") != std::string::npos);
+    }
+    REQUIRE(json.find("\"ph\":\"B\",\"name\":\"traced_ok\"") != std::string::npos);
+    REQUIRE(json.find("\"ph\":\"b\"") != std::string::npos);
+    REQUIRE(json.find("\"ph\":\"e\"") != std::string::npos);
+    REQUIRE(json.find("traced_\\\"flaky\\\"") != std::string::npos);
+}
+
+TEST_CASE("job profiler attributes CPU time to job names") {
+    JobProfiler::instance().enable(true);
+    {
+        ThreadPool pool(1, 10);
+        for (int i = 0; i < 3; ++i) {
+            pool.submit(JobMetadata(i, "profile_spin"), [] {
+                const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(5);
+                volatile uint64_t x = 0;
+                while (std::chrono::steady_clock::now() < until) ++x;
+            });
+        }
+        pool.submit(JobMetadata(3, "profile_sleep"), [] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        });
+        pool.shutdown();
+    }
+    JobProfiler::instance().disable();
+
+    JobProfiler::Profile spin, sleep;
+    for (const auto& p : JobProfiler::instance().profile()) {
+        if (p.job == "profile_spin") spin = p;
+        if (p.job == "profile_sleep") sleep = p;
+    }
+    REQUIRE(spin.cpu.count == 3);
+    REQUIRE(sleep.cpu.count == 1);
+    REQUIRE(spin.cpu.sum > sleep.cpu.sum);
+    REQUIRE(sleep.wall_seconds >= 0.015);
+    REQUIRE(sleep.cpu.sum < sleep.wall_seconds / 2);
+    REQUIRE(spin.cpu.quantile(0.99) > 0.0);
+
+    std::ostringstream table;
+    JobProfiler::instance().dump_profile(table);
+    REQUIRE(table.str().find("profile_spin") != std::string::npos);
+}
+
+TEST_CASE("watchdog flags a stuck worker and compensates for it") {
+    WatchdogOptions options;
+    options.stuck_threshold = std::chrono::milliseconds(50);
+    options.check_interval = std::chrono::milliseconds(10);
+    options.max_compensating_workers = 1;
+    ThreadPool pool(1, 10, options);
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    pool.submit(JobMetadata(7, "stuck"), [released] { released.wait(); });
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (pool.watchdog_stats().compensating_workers == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    const WatchdogStats stuck = pool.watchdog_stats();
+    REQUIRE(stuck.stuck_workers == 1);
+    REQUIRE(stuck.longest_running_job_id == 7);
+    REQUIRE(stuck.longest_running_seconds >= 0.05);
+    REQUIRE(stuck.compensating_workers == 1);
+    REQUIRE(stuck.stuck_jobs_total == 1);
+
+    // The only regular worker is blocked, so this runs on the compensating worker.
+    auto quick = pool.submit(JobMetadata(8, "quick"), [] { return 42; });
+    REQUIRE(quick.wait_for(std::chrono::seconds(2)) == std::future_status::ready);
+    REQUIRE(quick.get() == 42);
+
+    release.set_value();
+    pool.shutdown();
+    REQUIRE(pool.watchdog_stats().stuck_workers == 0);
+}
+
+TEST_CASE("blocking section starts a spare worker and retires it afterwards") {
+    WatchdogOptions options;
+    options.max_blocking_workers = 1;
+    ThreadPool pool(1, 10, options);
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> entered;
+    pool.submit(JobMetadata(1, "blocking_io"), [&pool, released, &entered] {
+        ThreadPool::BlockingSection blocking(pool);
+        entered.set_value();
+        released.wait();
+    });
+    entered.get_future().wait();
+    REQUIRE(pool.watchdog_stats().blocked_workers == 1);
+    REQUIRE(pool.watchdog_stats().compensating_workers == 1);
+
+    // The only regular worker is blocked, so this runs on the spare.
+    auto quick = pool.submit(JobMetadata(2, "quick"), [] { return 42; });
+    REQUIRE(quick.wait_for(std::chrono::seconds(2)) == std::future_status::ready);
+    REQUIRE(quick.get() == 42);
+
+    // The metadata hint opens a section around the whole task; the cap still holds.
+    JobMetadata hinted(3, "hinted");
+    hinted.blocking = true;
+    auto second = pool.submit(std::move(hinted), [&pool] { return pool.watchdog_stats().blocked_workers; });
+    REQUIRE(second.wait_for(std::chrono::seconds(2)) == std::future_status::ready);
+    REQUIRE(second.get() == 2);
+    REQUIRE(pool.watchdog_stats().compensating_workers == 1);
+
+    release.set_value();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (pool.watchdog_stats().blocked_workers != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    REQUIRE(pool.watchdog_stats().blocked_workers == 0);
+    // The spare retires at its next job boundary.
+    auto after = pool.submit(JobMetadata(4, "after"), [] { return 1; });
+    REQUIRE(after.get() == 1);
+    pool.shutdown();
+    REQUIRE(pool.watchdog_stats().compensating_workers == 0);
+}
+
+TEST_CASE("job recorder writes a trace that loads back in submit order") {
+    const std::string path = "test_job_recording.bin";
+    JobRecorder::instance().start(path);
+    {
+        ThreadPool pool(1, 10);
+        JobMetadata slow(1, "rec_slow");
+        slow.priority = 3;
+        pool.submit(std::move(slow), [] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+
+        JobMetadata expired(2, "rec_expired");
+        expired.timeout = std::chrono::milliseconds(1);
+        expired.allow_retry = false;
+        pool.submit(std::move(expired), [] {});
+
+        JobMetadata failing(3, "rec_fail");
+        failing.allow_retry = false;
+        pool.submit(std::move(failing), [] { throw std::runtime_error("boom"); });
+        pool.shutdown();
+    }
+    JobRecorder::instance().stop();
+    REQUIRE(JobRecorder::instance().recorded() == 3);
+
+    const auto records = JobRecorder::load(path);
+    std::remove(path.c_str());
+    REQUIRE(records.size() == 3);
+    REQUIRE(records[0].name == "rec_slow");
+    REQUIRE(records[0].priority == 3);
+    REQUIRE(records[0].flags == 0);
+    REQUIRE(records[0].run_ns >= 15000000);
+    REQUIRE(records[1].name == "rec_expired");
+    REQUIRE(records[1].timeout_ms == 1);
+    REQUIRE(records[1].flags == JobRecorder::kExpired);
+    REQUIRE(records[1].run_ns == 0);
+    REQUIRE(records[1].wait_ns >= 15000000);
+    REQUIRE(records[2].name == "rec_fail");
+    REQUIRE(records[2].flags == JobRecorder::kFailed);
+    REQUIRE(records[0].submit_ns <= records[1].submit_ns);
+    REQUIRE(records[1].submit_ns <= records[2].submit_ns);
+}
+
+TEST_CASE("submit_tagged delivers results and errors through the completion queue") {
+    CompletionQueue<int> completions(8); // smaller than the job count, so the ring overflows
+    ThreadPool pool(2, 64);
+    constexpr int kJobs = 40;
+    for (int i = 0; i < kJobs; ++i) {
+        JobMetadata meta(i, "tagged");
+        meta.allow_retry = false;
+        pool.submit_tagged(std::move(meta), completions, static_cast<uint64_t>(i), [i]() -> int {
+            if (i % 10 == 3) throw std::runtime_error("tagged failure");
+            return i * 2;
+        });
+    }
+
+#if defined(__linux__)
+    pollfd readable{completions.fd(), POLLIN, 0};
+    REQUIRE(poll(&readable, 1, 2000) == 1);
+#endif
+
+    std::vector<CompletionQueue<int>::Completion> done;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (done.size() < kJobs && std::chrono::steady_clock::now() < deadline) {
+        completions.wait(done, 16, std::chrono::milliseconds(100));
+    }
+    pool.shutdown();
+
+    REQUIRE(done.size() == kJobs);
+    std::vector<bool> seen(kJobs, false);
+    for (const auto& c : done) {
+        REQUIRE(c.tag < static_cast<uint64_t>(kJobs));
+        REQUIRE_FALSE(seen[c.tag]);
+        seen[c.tag] = true;
+        if (c.tag % 10 == 3) {
+            REQUIRE_FALSE(c.ok());
+            REQUIRE_THROWS_AS(std::rethrow_exception(c.error), std::runtime_error);
+        } else {
+            REQUIRE(c.ok());
+            REQUIRE(*c.value == static_cast<int>(c.tag) * 2);
+        }
+    }
+    REQUIRE(completions.empty());
+    std::vector<CompletionQueue<int>::Completion> none;
+    REQUIRE(completions.drain(none) == 0);
+#if defined(__linux__)
+    REQUIRE(poll(&readable, 1, 0) == 0);
+#endif
+}
+
+#if defined(__linux__)
+TEST_CASE("completion queue fd stays armed when a push races the drain's eventfd read") {
+    CompletionQueue<int> completions(8);
+    completions.push(1, 1);
+    // A push lands just before drain() reads the eventfd: the read consumes its write.
+    read_hook_fd = completions.fd();
+    read_hook = [&completions] { completions.push(2, 2); };
+    std::vector<CompletionQueue<int>::Completion> done;
+    REQUIRE(completions.drain(done) == 2);
+    read_hook_fd = -1;
+
+    pollfd readable{completions.fd(), POLLIN, 0};
+    REQUIRE(poll(&readable, 1, 0) == 0);
+    completions.push(3, 3);
+    REQUIRE(poll(&readable, 1, 0) == 1); // later pushes still signal
+    done.clear();
+    REQUIRE(completions.wait(done, 8, std::chrono::milliseconds(100)) == 1);
+    REQUIRE(done[0].tag == 3);
+}
+#endif
+
+TEST_CASE("try_submit and submit_for return a status instead of blocking on a full queue") {
+    ThreadPool pool(1, 2);
+    std::promise<void> gate;
+    auto gate_future = gate.get_future().share();
+    std::promise<void> started;
+    pool.submit(JobMetadata(0, "gate"), std::function<void()>([&started, gate_future]() {
+        started.set_value();
+        gate_future.wait();
+    }));
+    started.get_future().wait();
+
+    auto queued = [](int id, int priority) {
+        JobMetadata meta(id, "queued");
+        meta.priority = priority;
+        meta.allow_retry = false;
+        return meta;
+    };
+    auto first = pool.try_submit(queued(1, 5), [] { return 1; });
+    auto second = pool.try_submit(queued(2, 5), [] { return 2; });
+    REQUIRE(first.accepted());
+    REQUIRE(second.accepted());
+
+    auto rejected = pool.try_submit(queued(3, 0), [] { return 3; });
+    REQUIRE(rejected.status == SubmitStatus::Rejected);
+    REQUIRE_THROWS_AS(rejected.future.get(), std::runtime_error);
+
+    const auto before = std::chrono::steady_clock::now();
+    auto timed_out = pool.submit_for(queued(4, 0), std::chrono::milliseconds(20), [] { return 4; });
+    REQUIRE(timed_out.status == SubmitStatus::Timeout);
+    REQUIRE(std::chrono::steady_clock::now() - before >= std::chrono::milliseconds(20));
+
+    pool.set_overflow_policy(JobQueue::OverflowPolicy::DisplaceLower);
+    REQUIRE_THROWS_AS(pool.submit(queued(5, 5), [] { return 5; }), std::runtime_error);
+    bool failed = false;
+    REQUIRE(pool.try_submit(queued(6, 9), [] {}, [&failed](std::exception_ptr) { failed = true; }) ==
+            SubmitStatus::Rejected);
+    REQUIRE(failed);
+
+    auto urgent = pool.try_submit(queued(7, 0), [] { return 7; });
+    REQUIRE(urgent.accepted());
+    // One of the two priority-5 jobs was displaced and failed.
+    const bool first_dropped = first.future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    auto& dropped = first_dropped ? first.future : second.future;
+    auto& kept = first_dropped ? second.future : first.future;
+    REQUIRE_THROWS_AS(dropped.get(), std::runtime_error);
+
+    gate.set_value();
+    REQUIRE(urgent.future.get() == 7);
+    REQUIRE(kept.get() == (first_dropped ? 2 : 1));
+    pool.shutdown();
+    REQUIRE(pool.try_submit(queued(8, 0), [] { return 8; }).status == SubmitStatus::Shutdown);
+}
+
+TEST_CASE("reserved lane workers keep high-priority jobs moving behind a low-priority flood") {
+    LaneOptions lanes;
+    lanes.reserved_workers = 2;
+    lanes.max_priority = 1;
+    lanes.min_idle_reserved = 1;
+    ThreadPool pool(3, 64, {}, lanes);
+
+    std::promise<void> gate;
+    auto gate_future = gate.get_future().share();
+    std::atomic<int> running{0};
+    for (int i = 0; i < 6; ++i) {
+        JobMetadata meta(i, "flood");
+        meta.priority = 10;
+        pool.submit(std::move(meta), std::function<void()>([&running, gate_future]() {
+            running.fetch_add(1);
+            gate_future.wait();
+        }));
+    }
+    // The shared worker takes one; one lane worker borrows one and the other stays idle.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (running.load() < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(running.load() == 2);
+
+    JobMetadata urgent(100, "urgent");
+    urgent.priority = 1;
+    auto result = pool.submit(std::move(urgent), [] { return 42; });
+    REQUIRE(result.wait_for(std::chrono::seconds(2)) == std::future_status::ready);
+    REQUIRE(result.get() == 42);
+
+    gate.set_value();
+    pool.shutdown();
+
+    const LaneStats stats = pool.lane_stats();
+    REQUIRE(stats.reserved.workers == 2);
+    REQUIRE(stats.shared.workers == 1);
+    REQUIRE(stats.reserved.borrowed >= 1);
+    REQUIRE(stats.reserved.jobs + stats.shared.jobs == 7);
+    REQUIRE(stats.reserved.waits == 1);
+    REQUIRE(stats.shared.waits == 6);
+    REQUIRE(stats.shared.max_wait_seconds >= stats.shared.mean_wait_seconds);
+    REQUIRE(stats.reserved.utilization > 0.0);
+
+    REQUIRE_THROWS_AS(ThreadPool(2, 8, {}, lanes), std::runtime_error);
+}
+
+TEST_CASE("keyed strands run jobs for one key in order and one at a time") {
+    ThreadPool pool(2, 64);
+
+    // A blocked job holds its key's later jobs back without taking the second worker.
+    std::promise<void> gate;
+    auto gate_future = gate.get_future().share();
+    std::vector<int> order;
+    std::vector<std::future<void>> held;
+    for (int i = 0; i < 3; ++i) {
+        JobMetadata meta(i, "strand_a");
+        meta.strand_key = 1;
+        held.push_back(pool.submit(std::move(meta), [&order, i, gate_future] {
+            if (i == 0) gate_future.wait();
+            order.push_back(i);
+        }));
+    }
+    JobMetadata other(10, "strand_b");
+    other.strand_key = 2;
+    auto independent = pool.submit(std::move(other), [] { return 7; });
+    REQUIRE(independent.wait_for(std::chrono::seconds(2)) == std::future_status::ready);
+    REQUIRE(independent.get() == 7);
+    gate.set_value();
+    for (auto& f : held) f.get();
+    REQUIRE(order == std::vector<int>{0, 1, 2});
+
+    // Many keys interleaved: never two jobs of a key at once, always in submit order, and a
+    // failing job ends its turn like any other.
+    constexpr int kKeys = 4;
+    constexpr int kPerKey = 40;
+    std::atomic<int> in_flight[kKeys] = {};
+    std::atomic<bool> overlap{false};
+    std::vector<std::vector<int>> seen(kKeys);
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < kPerKey; ++i) {
+        for (int k = 0; k < kKeys; ++k) {
+            JobMetadata meta(i, "strand_mix");
+            meta.strand_key = 100 + k;
+            meta.allow_retry = false;
+            futures.push_back(pool.submit(std::move(meta), [&, k, i] {
+                if (in_flight[k].fetch_add(1) != 0) overlap = true;
+                seen[k].push_back(i);
+                in_flight[k].fetch_sub(1);
+                if (i == 5) throw std::runtime_error("strand job fails");
+            }));
+        }
+    }
+    int failures = 0;
+    for (auto& f : futures) {
+        try {
+            f.get();
+        } catch (const std::runtime_error&) {
+            ++failures;
+        }
+    }
+    REQUIRE(failures == kKeys);
+    REQUIRE_FALSE(overlap.load());
+    for (const auto& key : seen) {
+        REQUIRE(key.size() == static_cast<size_t>(kPerKey));
+        REQUIRE(std::is_sorted(key.begin(), key.end()));
+    }
+
+    // Shutdown drains held jobs like queued ones.
+    std::atomic<int> drained{0};
+    for (int i = 0; i < 20; ++i) {
+        JobMetadata meta(i, "strand_drain");
+        meta.strand_key = 3;
+        pool.submit(std::move(meta), std::function<void()>([&drained] { drained.fetch_add(1); }));
+    }
+    pool.shutdown();
+    REQUIRE(drained.load() == 20);
+}
+
+TEST_CASE("jobs held in a strand count against the queue bound") {
+    ThreadPool pool(1, 4);
+    pool.set_overflow_policy(JobQueue::OverflowPolicy::Reject);
+    std::promise<void> started;
+    std::promise<void> gate;
+    auto gate_future = gate.get_future().share();
+    pool.submit(JobMetadata(0, "blocker"), std::function<void()>([&started, gate_future] {
+        started.set_value();
+        gate_future.wait();
+    }));
+    started.get_future().wait();
+
+    std::vector<int> order;
+    std::vector<std::future<void>> accepted;
+    for (int i = 0; i < 10; ++i) {
+        JobMetadata meta(i + 1, "strand_bound");
+        meta.strand_key = 7;
+        auto submitted = pool.try_submit(std::move(meta), [&order, i] { order.push_back(i); });
+        if (submitted.accepted()) {
+            accepted.push_back(std::move(submitted.future));
+        } else {
+            REQUIRE(submitted.status == SubmitStatus::Rejected);
+        }
+    }
+    REQUIRE(accepted.size() == 4); // one queued, three held
+    REQUIRE(pool.try_submit(JobMetadata(20, "plain"), [] {}).status == SubmitStatus::Rejected);
+
+    gate.set_value();
+    for (auto& f : accepted) f.get();
+    REQUIRE(order == std::vector<int>{0, 1, 2, 3});
+
+    // Slots come back as held jobs run, whether handed off or queued.
+    JobMetadata after(30, "strand_bound");
+    after.strand_key = 7;
+    REQUIRE(pool.try_submit(std::move(after), [] {}).status == SubmitStatus::Accepted);
+    pool.shutdown();
+}
+
+TEST_CASE("submit_coalesced runs a queued key once and completes every caller's future") {
+    ThreadPool pool(1, 16);
+    std::promise<void> gate;
+    auto gate_future = gate.get_future().share();
+    pool.submit(JobMetadata(0, "blocker"), std::function<void()>([gate_future] { gate_future.wait(); }));
+
+    std::atomic<int> runs{0};
+    std::vector<std::shared_future<int>> results;
+    for (int i = 0; i < 5; ++i) {
+        JobMetadata meta(i + 1, "recompute");
+        meta.coalesce_key = 9;
+        results.push_back(pool.submit_coalesced(std::move(meta), [&runs] { return 40 + ++runs; }));
+    }
+    JobMetadata failing(10, "recompute_fail");
+    failing.coalesce_key = 10;
+    failing.allow_retry = false;
+    auto failed = pool.submit_coalesced(std::move(failing), []() -> int { throw std::runtime_error("boom"); });
+    JobMetadata failing_again(11, "recompute_fail");
+    failing_again.coalesce_key = 10;
+    auto failed_again = pool.submit_coalesced(std::move(failing_again), [] { return 0; });
+
+    JobMetadata plain(12, "plain");
+    plain.coalesce_key = 9;
+    REQUIRE_THROWS_AS(pool.submit(std::move(plain), [] { return 1; }), std::runtime_error);
+
+    gate.set_value();
+    for (auto& result : results) {
+        REQUIRE(result.get() == 41);
+    }
+    REQUIRE(runs.load() == 1);
+    REQUIRE_THROWS_AS(failed.get(), std::runtime_error);
+    REQUIRE_THROWS_AS(failed_again.get(), std::runtime_error);
+
+    // After the job started, the key is free: the next submit runs again.
+    JobMetadata next(13, "recompute");
+    next.coalesce_key = 9;
+    REQUIRE(pool.submit_coalesced(std::move(next), [&runs] { return 40 + ++runs; }).get() == 42);
+    pool.shutdown();
+}
+
+TEST_CASE("a coalesced job merged into a queued one releases the strand it opened") {
+    ThreadPool pool(1, 16);
+    std::promise<void> gate;
+    auto gate_future = gate.get_future().share();
+    pool.submit(JobMetadata(0, "blocker"), std::function<void()>([gate_future] { gate_future.wait(); }));
+
+    JobMetadata first(1, "recompute");
+    first.coalesce_key = 20;
+    auto merged_into = pool.submit_coalesced(std::move(first), [] { return 1; });
+    JobMetadata second(2, "recompute");
+    second.coalesce_key = 20;
+    second.strand_key = 5;
+    auto merged = pool.submit_coalesced(std::move(second), [] { return 2; });
+
+    JobMetadata later(3, "strand_after_merge");
+    later.strand_key = 5;
+    auto after = pool.submit(std::move(later), [] { return 3; });
+
+    gate.set_value();
+    REQUIRE(merged_into.get() == 1);
+    REQUIRE(merged.get() == 1);
+    REQUIRE(after.wait_for(std::chrono::seconds(2)) == std::future_status::ready);
+    REQUIRE(after.get() == 3);
+    pool.shutdown();
+}
+
+TEST_CASE("batched jobs count in lane stats like single jobs") {
+    LaneOptions lanes;
+    lanes.reserved_workers = 1;
+    lanes.max_priority = 1;
+    ThreadPool pool(2, 64, {}, lanes);
+    JobQueue::BatchOptions options;
+    options.max_size = 4;
+    pool.register_batch<int, int>(5, options, [](std::vector<int>& items) { return items; });
+
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 10; ++i) {
+        JobMetadata meta(i, "batched_lane");
+        meta.batch_key = 5;
+        meta.priority = i % 2 == 0 ? 0 : 10;
+        results.push_back(pool.submit_batched<int>(std::move(meta), i));
+    }
+    for (int i = 0; i < 10; ++i) REQUIRE(results[i].get() == i);
+    pool.shutdown();
+    const LaneStats stats = pool.lane_stats();
+    REQUIRE(stats.reserved.jobs + stats.shared.jobs == 10);
+    REQUIRE(stats.reserved.waits + stats.shared.waits == 10);
+}
+
+TEST_CASE("batched jobs run through one handler call and resolve their own futures") {
+    ThreadPool pool(1, 64);
+    std::mutex calls_mutex;
+    std::vector<size_t> calls;
+    JobQueue::BatchOptions options;
+    options.max_size = 8;
+    pool.register_batch<int, int>(7, options, [&](std::vector<int>& items) {
+        {
+            std::lock_guard<std::mutex> lock(calls_mutex);
+            calls.push_back(items.size());
+        }
+        if (std::find(items.begin(), items.end(), -1) != items.end()) {
+            throw std::runtime_error("bad item");
+        }
+        std::vector<int> doubled;
+        for (int item : items) doubled.push_back(item * 2);
+        return doubled;
+    });
+    auto duplicate = [&pool, options] {
+        pool.register_batch<int, int>(7, options, [](std::vector<int>& items) { return items; });
+    };
+    REQUIRE_THROWS_AS(duplicate(), std::runtime_error);
+
+    std::promise<void> gate;
+    auto gate_future = gate.get_future().share();
+    pool.submit(JobMetadata(0, "blocker"), std::function<void()>([gate_future] { gate_future.wait(); }));
+
+    auto batched = [](int id) {
+        JobMetadata meta(id, "batched_write");
+        meta.batch_key = 7;
+        return meta;
+    };
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 20; ++i) {
+        results.push_back(pool.submit_batched<int>(batched(i), i));
+    }
+    REQUIRE_THROWS_AS(pool.submit_batched<long>(batched(99), 1), std::runtime_error);
+    JobMetadata unregistered(98, "unregistered");
+    unregistered.batch_key = 8;
+    REQUIRE_THROWS_AS(pool.submit_batched<int>(std::move(unregistered), 1), std::runtime_error);
+    // Only submit_batched may carry a batch_key: no other submit registers the job with a runner.
+    REQUIRE_THROWS_AS(pool.submit(batched(97), [] { return 1; }), std::runtime_error);
+    REQUIRE_THROWS_AS(pool.submit(batched(96), std::function<void()>([] {})), std::runtime_error);
+    REQUIRE_THROWS_AS(pool.try_submit(batched(95), [] { return 1; }), std::runtime_error);
+    REQUIRE_THROWS_AS(pool.try_submit(batched(94), std::function<void()>([] {}), nullptr), std::runtime_error);
+
+    gate.set_value();
+    for (int i = 0; i < 20; ++i) {
+        REQUIRE(results[i].get() == i * 2);
+    }
+    {
+        std::lock_guard<std::mutex> lock(calls_mutex);
+        REQUIRE(calls == std::vector<size_t>{8, 8, 4});
+        calls.clear();
+    }
+
+    // A throwing handler fails the items of its batch.
+    auto bad = pool.submit_batched<int>(batched(31), -1);
+    REQUIRE_THROWS_AS(bad.get(), std::runtime_error);
+
+    // Linger: the worker waits for a second item instead of running a batch of one.
+    JobQueue::BatchOptions lingering;
+    lingering.max_size = 2;
+    lingering.linger = std::chrono::seconds(2);
+    pool.register_batch<int, void>(9, lingering, [&](std::vector<int>& items) {
+        std::lock_guard<std::mutex> lock(calls_mutex);
+        calls.push_back(items.size());
+    });
+    JobMetadata first(40, "lingering");
+    first.batch_key = 9;
+    auto a = pool.submit_batched<void>(std::move(first), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    JobMetadata second(41, "lingering");
+    second.batch_key = 9;
+    auto b = pool.submit_batched<void>(std::move(second), 2);
+    REQUIRE(a.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+    b.get();
+    {
+        std::lock_guard<std::mutex> lock(calls_mutex);
+        REQUIRE(calls.back() == 2);
+    }
+    pool.shutdown();
+}
@@ -1,5 +1,8 @@
 #include <catch2/catch_all.hpp>
 #include "JobQueue.hpp"
+#include <chrono>
+#include <optional>
+#include <thread>
 
 int main(int argc, char* argv[]) {
     return Catch::Session().run(argc, argv);
@@ -39,3 +42,296 @@ TEST_CASE("Shutdown prevents further pop", "[JobQueue]") {
     REQUIRE(queue.is_shutdown() == true);
 }
 
+
+#ifdef JOBQUEUE_CONTENTION_STATS
+TEST_CASE("Contention stats record parked consumers and blocked producers", "[JobQueue]") {
+    JobQueue queue(1);
+
+    std::thread consumer([&] { queue.pop(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.push(JobQueue::Job{JobMetadata(1, "a"), [] {}});
+    consumer.join();
+
+    queue.push(JobQueue::Job{JobMetadata(2, "b"), [] {}});
+    std::thread producer([&] { queue.push(JobQueue::Job{JobMetadata(3, "c"), [] {}}); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.pop();
+    producer.join();
+
+    const auto stats = queue.contention();
+    REQUIRE(stats.consumer_waits == 1);
+    REQUIRE(stats.consumer_park_ns >= 10000000);
+    REQUIRE(stats.producer_waits == 1);
+    REQUIRE(stats.producer_block_ns >= 10000000);
+    REQUIRE(stats.lock_acquisitions >= 5);
+    REQUIRE(stats.lock_contended <= stats.lock_acquisitions);
+}
+#endif
+
+TEST_CASE("Overflow policies decide which job a full queue keeps", "[JobQueue]") {
+    using Policy = JobQueue::OverflowPolicy;
+    auto job = [](int id, int priority) {
+        JobMetadata meta(id, "job");
+        meta.priority = priority;
+        return JobQueue::Job{std::move(meta), [] {}};
+    };
+    const auto now = std::chrono::steady_clock::now();
+
+    JobQueue queue(2);
+    REQUIRE(queue.push(job(1, 5)));
+    REQUIRE(queue.push(job(2, 5)));
+
+    std::optional<JobQueue::Job> evicted;
+    auto incoming = job(3, 5);
+    REQUIRE(queue.push(incoming, now, Policy::Reject, evicted) == JobQueue::PushStatus::Full);
+    REQUIRE(queue.push(incoming, now + std::chrono::milliseconds(10), Policy::Block, evicted) ==
+            JobQueue::PushStatus::Timeout);
+    REQUIRE(queue.push(incoming, now, Policy::DisplaceLower, evicted) == JobQueue::PushStatus::Full);
+    REQUIRE_FALSE(evicted);
+    REQUIRE(incoming.task); // not consumed
+
+    // Equal priority: DropOldest evicts the oldest queued job.
+    REQUIRE(queue.push(incoming, now, Policy::DropOldest, evicted) == JobQueue::PushStatus::Ok);
+    REQUIRE(evicted);
+    REQUIRE(evicted->metadata.id == 1);
+
+    evicted.reset();
+    auto lower = job(4, 9);
+    REQUIRE(queue.push(lower, now, Policy::DropOldest, evicted) == JobQueue::PushStatus::Full);
+    auto higher = job(5, 0);
+    REQUIRE(queue.push(higher, now, Policy::DisplaceLower, evicted) == JobQueue::PushStatus::Ok);
+    REQUIRE(evicted->metadata.id == 2);
+
+    REQUIRE(queue.pop().metadata.id == 5);
+    REQUIRE(queue.pop().metadata.id == 3);
+}
+
+TEST_CASE("Jobs with a queued coalesce_key merge into the queued job", "[JobQueue]") {
+    using Policy = JobQueue::OverflowPolicy;
+    auto job = [](int id, int priority, uint64_t key) {
+        JobMetadata meta(id, "job");
+        meta.priority = priority;
+        meta.coalesce_key = key;
+        return JobQueue::Job{std::move(meta), [] {}};
+    };
+    const auto now = std::chrono::steady_clock::now();
+
+    JobQueue queue(3);
+    REQUIRE(queue.push(job(1, 5, 0)));
+    REQUIRE(queue.push(job(2, 9, 42)));
+    REQUIRE(queue.push(job(3, 7, 0)));
+
+    // The queue is full, but a merge adds no entry. The merged job takes the higher
+    // priority and the earlier deadline, and both failure handlers run.
+    int failures = 0;
+    std::optional<JobQueue::Job> evicted;
+    auto duplicate = job(4, 1, 42);
+    duplicate.metadata.timeout = std::chrono::milliseconds(500);
+    duplicate.on_terminal_failure = [&failures](std::exception_ptr) { ++failures; };
+    REQUIRE(queue.push(duplicate, now, Policy::Reject, evicted) == JobQueue::PushStatus::Merged);
+    REQUIRE(duplicate.task); // not consumed
+    auto later = job(5, 3, 42);
+    later.metadata.timeout = std::chrono::milliseconds(5000);
+    later.on_terminal_failure = [&failures](std::exception_ptr) { ++failures; };
+    REQUIRE(queue.push(later, now, Policy::Reject, evicted) == JobQueue::PushStatus::Merged);
+
+    auto merged = queue.pop();
+    REQUIRE(merged.metadata.id == 2);
+    REQUIRE(merged.metadata.priority == 1);
+    REQUIRE(merged.metadata.timeout > std::chrono::milliseconds(0));
+    REQUIRE(merged.metadata.timeout <= std::chrono::milliseconds(501));
+    merged.on_terminal_failure(nullptr);
+    REQUIRE(failures == 2);
+
+    // Once popped, the key is free again; a retry of it never becomes a merge target.
+    merged.metadata.current_retry = 1;
+    REQUIRE(queue.push(std::move(merged)));
+    auto fresh = job(6, 7, 42);
+    REQUIRE(queue.push(fresh, now, Policy::DropOldest, evicted) == JobQueue::PushStatus::Ok);
+    REQUIRE(evicted);
+    REQUIRE(evicted->metadata.id == 3);
+    auto again = job(7, 9, 42);
+    REQUIRE(queue.push(again, now, Policy::Reject, evicted) == JobQueue::PushStatus::Merged);
+
+    REQUIRE(queue.pop().metadata.id == 2);
+    REQUIRE(queue.pop().metadata.id == 1);
+    REQUIRE(queue.pop().metadata.id == 6);
+}
+
+TEST_CASE("reprioritize moves queued jobs in place by handle or group", "[JobQueue]") {
+    JobQueue queue(64);
+    auto job = [](int id, int priority, uint64_t handle, uint64_t group) {
+        JobMetadata meta(id, "job");
+        meta.priority = priority;
+        meta.handle = handle;
+        meta.group = group;
+        return JobQueue::Job{std::move(meta), [] {}};
+    };
+    for (int i = 0; i < 20; ++i) {
+        REQUIRE(queue.push(job(i, 10, 100 + i, i % 2 == 0 ? 7 : 8)));
+    }
+
+    REQUIRE(queue.reprioritize(115, 1));
+    REQUIRE(queue.reprioritize(102, 20));
+    REQUIRE_FALSE(queue.reprioritize(999, 1));
+    REQUIRE(queue.pop().metadata.id == 15);
+    REQUIRE_FALSE(queue.reprioritize(115, 0)); // no longer queued
+
+    // Group 7 holds the even ids; 102 was demoted but still moves with its group. Jobs keep
+    // their enqueue order within a priority.
+    REQUIRE(queue.reprioritize_group(7, 3) == 10);
+    for (int id = 0; id < 20; id += 2) {
+        REQUIRE(queue.pop().metadata.id == id);
+    }
+    // Handles still resolve after the group rebuild.
+    REQUIRE(queue.reprioritize(119, 2));
+    REQUIRE(queue.pop().metadata.id == 19);
+    for (int id = 1; id < 19; id += 2) {
+        if (id != 15) REQUIRE(queue.pop().metadata.id == id);
+    }
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("CoDel shedding drops low-priority work once queue wait stays above target", "[JobQueue]") {
+    JobQueue queue(16);
+    JobQueue::SheddingOptions options;
+    options.target = std::chrono::milliseconds(1);
+    options.interval = std::chrono::milliseconds(5);
+    options.shed_priority = 5;
+    queue.set_shedding(options);
+
+    const auto old = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+    auto job = [](int id, int priority, std::chrono::steady_clock::time_point enqueued) {
+        JobMetadata meta(id, "job");
+        meta.priority = priority;
+        meta.enqueue_time = enqueued;
+        return JobQueue::Job{std::move(meta), [] {}};
+    };
+    queue.push(job(1, 6, old));
+    queue.push(job(2, 6, old + std::chrono::milliseconds(1)));
+    queue.push(job(3, 9, old));
+    queue.push(job(4, 9, old + std::chrono::milliseconds(1)));
+
+    std::vector<JobQueue::Job> shed;
+    REQUIRE(queue.pop(&shed).metadata.id == 1); // above target: interval starts
+    REQUIRE(shed.empty());
+    REQUIRE_FALSE(queue.shedding());
+    std::this_thread::sleep_for(std::chrono::milliseconds(6));
+    REQUIRE(queue.pop(&shed).metadata.id == 2); // still above target after an interval
+    REQUIRE(queue.shedding());
+    REQUIRE(shed.size() == 1);
+    REQUIRE(shed[0].metadata.id == 3);
+
+    std::optional<JobQueue::Job> evicted;
+    auto low = job(5, 9, std::chrono::steady_clock::now());
+    auto high = job(6, 0, std::chrono::steady_clock::now());
+    const auto later = std::chrono::steady_clock::time_point::max();
+    REQUIRE(queue.push(low, later, JobQueue::OverflowPolicy::Block, evicted) == JobQueue::PushStatus::Overloaded);
+    REQUIRE(queue.push(high, later, JobQueue::OverflowPolicy::Block, evicted) == JobQueue::PushStatus::Ok);
+
+    REQUIRE(queue.pop(&shed).metadata.id == 6); // protected jobs are not measured
+    REQUIRE(queue.shedding());
+    REQUIRE(queue.pop(&shed).metadata.id == 4); // queue drained: shedding ends
+    REQUIRE_FALSE(queue.shedding());
+    REQUIRE(queue.push(low, later, JobQueue::OverflowPolicy::Block, evicted) == JobQueue::PushStatus::Ok);
+}
+
+TEST_CASE("CoDel shedding ends once the last sheddable job is shed", "[JobQueue]") {
+    JobQueue queue(16);
+    JobQueue::SheddingOptions options;
+    options.target = std::chrono::milliseconds(1);
+    options.interval = std::chrono::milliseconds(5);
+    options.shed_priority = 5;
+    queue.set_shedding(options);
+
+    const auto old = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+    auto job = [](int id, int priority, std::chrono::steady_clock::time_point enqueued) {
+        JobMetadata meta(id, "job");
+        meta.priority = priority;
+        meta.enqueue_time = enqueued;
+        return JobQueue::Job{std::move(meta), [] {}};
+    };
+    queue.push(job(1, 6, old));
+    queue.push(job(2, 6, old + std::chrono::milliseconds(1)));
+    queue.push(job(3, 9, old));
+    queue.push(job(4, 0, old));
+    queue.push(job(5, 1, old));
+
+    std::vector<JobQueue::Job> shed;
+    REQUIRE(queue.pop(&shed).metadata.id == 4); // protected: not measured
+    REQUIRE(queue.pop(&shed).metadata.id == 5);
+    REQUIRE(queue.pop(&shed).metadata.id == 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(6));
+    queue.push(job(6, 0, old));
+    REQUIRE(queue.pop(&shed).metadata.id == 6);
+    REQUIRE(queue.pop(&shed).metadata.id == 2);
+    REQUIRE(queue.shedding());
+    REQUIRE(shed.size() == 1); // job 3, the last sheddable one
+    REQUIRE(queue.empty());
+
+    // Only protected work follows; it must not leave the queue latched in overload.
+    queue.push(job(7, 0, std::chrono::steady_clock::now()));
+    queue.push(job(8, 0, std::chrono::steady_clock::now()));
+    REQUIRE(queue.pop(&shed).metadata.id == 7);
+    REQUIRE_FALSE(queue.shedding());
+
+    std::optional<JobQueue::Job> evicted;
+    auto low = job(9, 9, std::chrono::steady_clock::now());
+    REQUIRE(queue.push(low, std::chrono::steady_clock::time_point::max(), JobQueue::OverflowPolicy::Block,
+                       evicted) == JobQueue::PushStatus::Ok);
+}
+
+TEST_CASE("take_batch keeps to the lane's priorities and does not linger over other work", "[JobQueue]") {
+    JobQueue queue(16);
+    JobQueue::BatchOptions options;
+    options.max_size = 8;
+    options.linger = std::chrono::seconds(2);
+    queue.set_batching(7, options);
+
+    auto job = [](int id, int priority, uint64_t batch_key) {
+        JobMetadata meta(id, "job");
+        meta.priority = priority;
+        meta.batch_key = batch_key;
+        return JobQueue::Job{std::move(meta), [] {}};
+    };
+    queue.push(job(1, 0, 7));
+    queue.push(job(2, 5, 7));
+    queue.push(job(3, 0, 7));
+    queue.push(job(4, 3, 0));
+
+    std::vector<JobQueue::Job> batch;
+    batch.push_back(queue.pop());
+    REQUIRE(batch[0].metadata.id == 1);
+    const auto start = std::chrono::steady_clock::now();
+    queue.take_batch(batch, 1);
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(1)); // job 4 is waiting
+    REQUIRE(batch.size() == 2);
+    REQUIRE(batch[1].metadata.id == 3); // job 2 is above the lane's max_priority
+    REQUIRE(queue.pop().metadata.id == 4);
+    REQUIRE(queue.pop().metadata.id == 2);
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("coalescing still merges after one of two same-key queued jobs leaves", "[JobQueue]") {
+    JobQueue queue(16);
+    auto job = [](int id, int priority) {
+        JobMetadata meta(id, "job");
+        meta.priority = priority;
+        meta.coalesce_key = 9;
+        return JobQueue::Job{std::move(meta), [] {}};
+    };
+    const auto later = std::chrono::steady_clock::time_point::max();
+    std::optional<JobQueue::Job> evicted;
+    auto first = job(1, 1);
+    REQUIRE(queue.push(first, later, JobQueue::OverflowPolicy::Block, evicted) == JobQueue::PushStatus::Ok);
+    // A held strand job comes back through reserve() and requeue(), which never merge.
+    auto held = job(2, 5);
+    REQUIRE(queue.reserve(held, later, JobQueue::OverflowPolicy::Block, evicted) == JobQueue::PushStatus::Ok);
+    REQUIRE(queue.requeue(held));
+
+    REQUIRE(queue.pop().metadata.id == 1);
+    auto next = job(3, 5);
+    REQUIRE(queue.push(next, later, JobQueue::OverflowPolicy::Block, evicted) == JobQueue::PushStatus::Merged);
+    REQUIRE(queue.pop().metadata.id == 2);
+    REQUIRE(queue.empty());
+}
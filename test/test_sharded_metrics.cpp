@@ -0,0 +1,118 @@
+#include <catch2/catch_all.hpp>
+#include "ShardedMetrics.hpp"
+#include "JobLatencyMetrics.hpp"
+#include <string>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    return Catch::Session().run(argc, argv);
+}
+
+TEST_CASE("Sharded counter sums updates from all threads", "[ShardedMetrics]") {
+    ShardedCounter counter;
+    ShardedGauge gauge;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 1000; ++i) {
+                counter.Increment();
+                gauge.Increment();
+            }
+            gauge.Decrement(500);
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    // Threads have exited, so these values come from the folded retired totals.
+    REQUIRE(counter.Value() == 4000);
+    REQUIRE(gauge.Value() == 2000);
+
+    counter.Increment(5);
+    REQUIRE(counter.Value() == 4005);
+}
+
+TEST_CASE("Sharded histogram produces cumulative buckets", "[ShardedMetrics]") {
+    ShardedHistogram histogram{0.1, 1.0};
+
+    histogram.Observe(0.05);
+    histogram.Observe(0.1); // upper bounds are inclusive
+    histogram.Observe(0.5);
+    std::thread([&] { histogram.Observe(5.0); }).join();
+
+    auto snap = histogram.snapshot();
+    REQUIRE(snap.cumulative_counts.size() == 3);
+    REQUIRE(snap.cumulative_counts[0] == 2);
+    REQUIRE(snap.cumulative_counts[1] == 3);
+    REQUIRE(snap.cumulative_counts[2] == 4);
+    REQUIRE(snap.count == 4);
+    REQUIRE(std::abs(snap.sum - 5.65) < 1e-9);
+}
+
+TEST_CASE("Log-linear histogram buckets cover microseconds to minutes", "[ShardedMetrics]") {
+    const auto& bounds = ShardedLogHistogram::upper_bounds();
+    REQUIRE(bounds.size() == ShardedLogHistogram::kFiniteBuckets);
+    REQUIRE(bounds.front() < 2e-6);
+    REQUIRE(bounds.back() > 3600.0);
+
+    // Every value lands in the bucket whose inclusive upper bound is the first >= value,
+    // and that bound is within 12.5% of the value.
+    for (int64_t nanos : {int64_t(1), int64_t(1024), int64_t(1025), int64_t(1500), int64_t(2048),
+                          int64_t(2049), int64_t(123456789), int64_t(60) * 1000000000}) {
+        const size_t bucket = ShardedLogHistogram::bucket_index(nanos);
+        REQUIRE(bucket < bounds.size());
+        const double seconds = static_cast<double>(nanos) * 1e-9;
+        REQUIRE(bounds[bucket] >= seconds - 1e-15);
+        if (bucket > 0) {
+            REQUIRE(bounds[bucket - 1] < seconds);
+            REQUIRE(bounds[bucket] <= seconds * 1.125 + 1e-15);
+        }
+    }
+    REQUIRE(ShardedLogHistogram::bucket_index(int64_t(1) << 50) == ShardedLogHistogram::kFiniteBuckets);
+
+    ShardedLogHistogram histogram;
+    histogram.ObserveNanos(500);
+    histogram.Observe(0.25);
+    std::thread([&] { histogram.Observe(90.0); }).join();
+    auto snap = histogram.snapshot();
+    REQUIRE(snap.count == 3);
+    REQUIRE(snap.cumulative_counts[0] == 1);
+    REQUIRE(snap.cumulative_counts.back() == 3);
+    REQUIRE(std::abs(snap.sum - 90.2500005) < 1e-9);
+}
+
+TEST_CASE("Job latency series have bounded label cardinality", "[ShardedMetrics]") {
+    JobLatencyMetrics timing;
+
+    const int a = timing.resolve("ComputeAnswer", 10);
+    REQUIRE(a > 0);
+    REQUIRE(timing.resolve("ComputeAnswer", 10) == a);
+    REQUIRE(timing.resolve("ComputeAnswer", 20) != a);
+    REQUIRE(timing.resolve(std::string("Compute") + "Answer", 10) == a);
+    REQUIRE(timing.series(a).job == "ComputeAnswer");
+    REQUIRE(timing.series(a).priority_label == "10");
+
+    for (size_t i = 0; i < JobLatencyMetrics::kMaxJobNames * 2; ++i) {
+        timing.resolve("job" + std::to_string(i), 10);
+    }
+    REQUIRE(timing.resolve("one-more-name", 10) == 0);
+    REQUIRE(timing.series(0).job == "other");
+    REQUIRE(timing.size() <= JobLatencyMetrics::kMaxSeries);
+
+    // Known names still get new priorities until the series table is full.
+    REQUIRE(timing.resolve("ComputeAnswer", 1) > 0);
+    for (int p = 100; p < 200; ++p) {
+        timing.resolve("ComputeAnswer", p);
+    }
+    REQUIRE(timing.size() == JobLatencyMetrics::kMaxSeries);
+    REQUIRE(timing.resolve("ComputeAnswer", 500) == 0);
+
+    timing.queue_wait(a).ObserveNanos(2000);
+    timing.queue_wait(-1).ObserveNanos(2000); // unresolved ids fall back to "other"
+    REQUIRE(timing.series(a).queue_wait.snapshot().count == 1);
+    REQUIRE(timing.series(0).queue_wait.snapshot().count == 1);
+}